@@ -0,0 +1,72 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_BACKGROUND_DELETE_H_
+#define SWRI_CONSOLE_BACKGROUND_DELETE_H_
+
+#include <QRunnable>
+#include <QThreadPool>
+
+namespace swri_console
+{
+template <class T>
+class BackgroundDeleteTask : public QRunnable
+{
+ public:
+  explicit BackgroundDeleteTask(T *data) : data_(data) {}
+  virtual void run() { delete data_; }
+
+ private:
+  T *data_;
+};
+
+// Deletes data on a thread pool thread.  Suitable as a custom deleter
+// for QSharedPointer.
+template <class T>
+void deleteInBackground(T *data)
+{
+  QThreadPool::globalInstance()->start(new BackgroundDeleteTask<T>(data));
+}
+
+// Empties a container in O(1) by swapping its contents into a
+// temporary that is destroyed on a thread pool thread.  This keeps
+// the GUI responsive when clearing containers with millions of
+// elements.  The elements must be safe to destroy from another
+// thread, which is the case for implicitly shared Qt types as long as
+// no other thread is using them.
+template <class T>
+void clearInBackground(T &container)
+{
+  T *old = new T();
+  old->swap(container);
+  deleteInBackground(old);
+}
+}  // namespace swri_console
+#endif  // SWRI_CONSOLE_BACKGROUND_DELETE_H_
@@ -0,0 +1,184 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_BAG_INDEX_H_
+#define SWRI_CONSOLE_BAG_INDEX_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <QFile>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QString>
+#include <QTemporaryFile>
+
+#include <rosbag/bag.h>
+#include <rosgraph_msgs/Log.h>
+
+#include <swri_console/log_body_source.h>
+#include <swri_console/log_database.h>
+#include <swri_console/string_table.h>
+
+namespace swri_console
+{
+// A sidecar index is written next to a bag file the first time it is
+// read, so that reopening the bag doesn't require decoding it again.
+// The index holds everything about each log message except its text,
+// which is fetched from the bag when it is needed.
+//
+// The file consists of a header, the string tables (nodes, files,
+// functions and message templates), and one column per field, in
+// native byte order:
+//
+//   stamp, receipt time      (uint64_t nanoseconds)
+//   seq, line, node, file,
+//   function, template,
+//   line count               (uint32_t)
+//   level                    (uint8_t)
+//
+// The receipt time is the time the message was recorded in the bag,
+// which is used to find the message again.
+
+// Returns the path of the sidecar index for a bag file.  If the bag's
+// directory isn't writable, the index is kept in the temp directory.
+QString bagIndexPath(const QString &bag_filename);
+
+// Builds an index while a bag is being read.  Rows are kept in memory
+// in blocks and full blocks are spilled to a temporary file, so
+// building the index of a large bag doesn't hold all of its rows.
+class BagIndexWriter
+{
+ public:
+  BagIndexWriter();
+
+  void add(const rosgraph_msgs::Log &msg, const ros::Time &receipt_time);
+
+  // Writes the index for the bag at bag_filename.  Returns false if it
+  // couldn't be written, e.g. because the directory is read-only.
+  bool write(const QString &bag_filename);
+
+ private:
+  void spillBlock();
+  bool writeBlockColumn(QIODevice *device, size_t column) const;
+  bool copySpilledColumn(QIODevice *device, size_t column);
+
+  // Rows in each block of the spill file.  Each block holds its rows'
+  // columns one after another.
+  std::vector<uint32_t> spilled_blocks_;
+  uint64_t spilled_rows_;
+  QTemporaryFile spill_;
+  bool spill_failed_;
+
+  StringTable nodes_;
+  StringTable files_;
+  StringTable functions_;
+  StringTable templates_;
+
+  std::vector<uint64_t> stamps_;
+  std::vector<uint64_t> receipt_times_;
+  std::vector<uint32_t> seqs_;
+  std::vector<uint32_t> lines_;
+  std::vector<uint32_t> node_ids_;
+  std::vector<uint32_t> file_ids_;
+  std::vector<uint32_t> function_ids_;
+  std::vector<uint32_t> template_ids_;
+  std::vector<uint32_t> line_counts_;
+  std::vector<uint8_t> levels_;
+};
+
+// A memory-mapped sidecar index.
+class BagIndex
+{
+ public:
+  // Returns the index for bag_filename, or a null pointer if there
+  // isn't one or it is out of date.
+  static QSharedPointer<BagIndex> open(const QString &bag_filename);
+
+  size_t size() const { return rows_; }
+
+  // Fills in everything but the message text for a row.  The body
+  // locator is the row number.
+  void message(size_t row, IndexedMessage *msg) const;
+
+  ros::Time receiptTime(size_t row) const;
+  ros::Time stamp(size_t row) const;
+  uint32_t seq(size_t row) const { return seqs_[row]; }
+  const std::string& node(size_t row) const { return nodes_[node_ids_[row]]; }
+
+ private:
+  BagIndex(const QString &path);
+  bool load(const QString &bag_filename);
+
+  QFile file_;
+  size_t rows_;
+
+  std::vector<std::string> nodes_;
+  std::vector<std::string> files_;
+  std::vector<std::string> functions_;
+  std::vector<QByteArray> templates_;
+
+  // Columns, pointing into the mapped file.
+  const uint64_t *stamps_;
+  const uint64_t *receipt_times_;
+  const uint32_t *seqs_;
+  const uint32_t *lines_;
+  const uint32_t *node_ids_;
+  const uint32_t *file_ids_;
+  const uint32_t *function_ids_;
+  const uint32_t *template_ids_;
+  const uint32_t *line_counts_;
+  const uint8_t *levels_;
+};
+
+// Fetches the text of indexed messages from their bag file.
+class BagBodySource : public LogBodySource
+{
+ public:
+  BagBodySource(const QString &bag_filename, const QSharedPointer<BagIndex> &index);
+
+  virtual QStringList text(uint64_t locator);
+  virtual void textRange(uint64_t first, size_t count, std::vector<QStringList> *texts);
+
+ private:
+  bool openBag();
+  bool matches(const rosgraph_msgs::Log &log, uint64_t row) const;
+
+  QString bag_filename_;
+  QSharedPointer<BagIndex> index_;
+  // The bag is opened when the first message is fetched.  It is
+  // shared by every thread reading from the source.
+  QMutex mutex_;
+  rosbag::Bag bag_;
+  bool bag_open_;
+};
+}  // namespace swri_console
+#endif  // SWRI_CONSOLE_BAG_INDEX_H_
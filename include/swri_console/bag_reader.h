@@ -33,42 +33,228 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
+#include <QThread>
 #include <QMetaType>
+#include <QSet>
+#include <QSharedPointer>
+
+#include <set>
+#include <string>
+#include <vector>
 
 #include <rosgraph_msgs/Log.h>
+#include <swri_console/log_database.h>
+
+class QProgressDialog;
 
 namespace swri_console
 {
+  class BagIndex;
+  class BagIndexWriter;
+
+  /**
+   * Restricts which messages are imported from a bag file.  Messages are
+   * tested after decoding only their level and node name, so rejected
+   * messages are never fully deserialized or stored.
+   */
+  struct BagImportFilter
+  {
+    BagImportFilter() : severity_mask(0xFF) {}
+
+    // Only messages whose level is set in this mask are imported.
+    uint8_t severity_mask;
+    // Only messages from the nodes in names, or from a node whose name
+    // starts with one of the prefixes, are imported.  If both are
+    // empty, messages from every node are imported.
+    std::set<std::string> names;
+    std::set<std::string> prefixes;
+
+    bool acceptsAll() const;
+    bool acceptNode(const std::string& name) const;
+  };
+
+  /**
+   * Reads the log messages from one or more bag files on a background
+   * thread.  Messages are read from every rosgraph_msgs/Log topic, and
+   * messages from several bags are merged into a single stream ordered by
+   * receipt time.  Messages recorded more than once are delivered once.
+   */
+  class BagReaderThread : public QThread
+  {
+    Q_OBJECT
+  public:
+    /**
+     * When browse is set, a single bag is only indexed up front; its
+     * messages are loaded from the index and their text is fetched from
+     * the bag when it is needed.
+     */
+    BagReaderThread(const QStringList& filenames,
+                    const BagImportFilter& filter = BagImportFilter(),
+                    bool browse = false);
+
+    /**
+     * Asks the thread to stop reading.  Messages that were already
+     * delivered are kept.
+     */
+    void cancel();
+
+    /**
+     * Limits how many threads decode a single bag.  The default of 0
+     * uses one thread per core.
+     */
+    void setMaxThreads(int threads) { max_threads_ = threads; }
+
+    bool wasCancelled() const { return cancelled_; }
+    const QString& errorString() const { return error_; }
+
+  Q_SIGNALS:
+    /**
+     * Emitted with batches of messages as they are read.
+     */
+    void messagesRead(const MessageList& msgs);
+
+    /**
+     * Emitted with batches of messages loaded from a bag's sidecar index.
+     */
+    void indexedMessagesRead(const IndexedMessageBatch& batch);
+
+    /**
+     * Emitted as the thread advances through the bag's time span,
+     * with progress between 0 and 1000.
+     */
+    void progress(int permille);
+
+  protected:
+    void run();
+
+  private:
+    void readPartitioned(const QString& filename, uint32_t count,
+                         BagIndexWriter* writer, bool deliver);
+    void readMerged(const QStringList& filenames);
+    void readIndexed(const QString& filename, const QSharedPointer<BagIndex>& index);
+    void removeDuplicates(MessageList* msgs, const ros::Time& batch_time,
+                          std::vector<ros::Time>* times = NULL);
+    // Returns false if the fingerprint was already seen.
+    bool insertFingerprint(quint64 fingerprint);
+    void reportProgress(const ros::Time& time);
+
+    // An open-addressed set of 64-bit fingerprints, where zero marks
+    // an empty slot.
+    class FingerprintSet
+    {
+    public:
+      FingerprintSet() : count_(0) {}
+
+      bool contains(quint64 fingerprint) const;
+      void insert(quint64 fingerprint);
+      // Empties the set and releases its memory.
+      void clear();
+      void swap(FingerprintSet& other);
+
+    private:
+      std::vector<quint64> slots_;
+      size_t count_;
+    };
+
+    QStringList filenames_;
+    BagImportFilter filter_;
+    bool browse_;
+    QString error_;
+    volatile bool cancelled_;
+    int max_threads_;
+
+    ros::Time begin_;
+    ros::Time end_;
+    int last_progress_;
+
+    // Fingerprints of the messages that have been delivered recently.
+    // Copies of a message are recorded close together, so fingerprints
+    // are kept in two generations that each cover a window of receipt
+    // time, and the older one is dropped when a new one starts.
+    FingerprintSet seen_;
+    FingerprintSet seen_previous_;
+    ros::Time seen_start_;
+  };
+
   class BagReader : public QObject
   {
     Q_OBJECT
   public:
+    BagReader();
+    ~BagReader();
+
     /**
-     * Reads a bag file at the specified path.  Any log messages that were broadcast on the
-     * /rosout topic will be loaded and displayed.
+     * Starts reading a bag file at the specified path in the background.  Any log messages
+     * that were recorded on any rosgraph_msgs/Log topic will be loaded and displayed.
      * @param[in] filename The name of the bag file to load.
      */
     void readBagFile(const QString& filename);
 
+    /**
+     * Starts reading several bag files in the background.  Their log
+     * messages are merged and delivered in receipt time order.
+     * @param[in] filenames The names of the bag files to load.
+     */
+    void readBagFiles(const QStringList& filenames,
+                      const BagImportFilter& filter = BagImportFilter());
+
+    /**
+     * Starts browsing a bag file.  The bag is indexed without keeping the message text in
+     * memory; text is read from the bag as messages are displayed or filtered.  This is
+     * meant for bags that are too large to load completely.
+     * @param[in] filename The name of the bag file to browse.
+     */
+    void browseBagFile(const QString& filename);
+
   public Q_SLOTS:
     /**
-     * Displays a file dialog that prompts the user to pick a bag file.  After picking a bag
-     * file, log messages in the bag will be read and displayed in the log console.
+     * Displays a file dialog that prompts the user to pick one or more bag files.  After
+     * picking them, log messages in the bags will be read and displayed in the log console.
      */
     void promptForBagFile();
 
+    /**
+     * Like promptForBagFile, but only messages accepted by the filter are
+     * imported from the bags.
+     */
+    void promptForFilteredBagFile(const BagImportFilter& filter);
+
+    /**
+     * Displays a file dialog that prompts the user to pick a bag file to browse.
+     */
+    void promptForBrowseBagFile();
+
   Q_SIGNALS:
 
     /**
-     * Emitted every time a log message is received.  This will likely be emitted several times
-     * per bag file; finishedReading will be emitted when we're done.
+     * Emitted with batches of log messages as they are read.  This will likely be emitted
+     * several times per bag file; finishedReading will be emitted when we're done.
+     */
+    void logsReceived(const MessageList& msgs);
+
+    /**
+     * Emitted with batches of log messages whose text stays in the bag file.  This is
+     * used instead of logsReceived when a bag is loaded from its sidecar index.
      */
-    void logReceived(const rosgraph_msgs::LogConstPtr& msg);
+    void indexedLogsReceived(const IndexedMessageBatch& batch);
 
     /**
      * Emitted after we're completely done reading the bag file.
      */
     void finishedReading();
+
+  private Q_SLOTS:
+    void cancelReading();
+    void handleThreadFinished();
+
+  private:
+    void startReading(const QStringList& filenames,
+                      const BagImportFilter& filter,
+                      bool browse);
+
+    BagReaderThread* thread_;
+    QProgressDialog* progress_dialog_;
   };
 }
 
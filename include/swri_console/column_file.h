@@ -0,0 +1,138 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_COLUMN_FILE_H_
+#define SWRI_CONSOLE_COLUMN_FILE_H_
+
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <QByteArray>
+#include <QIODevice>
+
+#include <swri_console/string_table.h>
+
+namespace swri_console
+{
+// Helpers for the index and session files, which store string tables
+// followed by fixed-width columns in native byte order.  A string
+// table is a uint32_t count followed by each string as a uint32_t
+// length and its bytes.
+
+inline void appendStringTable(QByteArray *data, const StringTable &table)
+{
+  uint32_t count = table.size();
+  data->append(reinterpret_cast<const char*>(&count), sizeof(count));
+  for (size_t i = 0; i < table.size(); i++) {
+    uint32_t length = table[i].size();
+    data->append(reinterpret_cast<const char*>(&length), sizeof(length));
+    data->append(table[i].data(), length);
+  }
+}
+
+// Reads a string table starting at *offset and advances *offset past
+// it.  Returns false if the table runs past the end of the data.
+inline bool readStringTable(const uchar *data, size_t size, size_t *offset,
+                            std::vector<std::string> *table)
+{
+  uint32_t count = 0;
+  if (*offset + sizeof(count) > size) {
+    return false;
+  }
+  std::memcpy(&count, data + *offset, sizeof(count));
+  *offset += sizeof(count);
+
+  // Every string takes at least its length, so a count that couldn't
+  // fit in the rest of the data is corrupt.  Checking it first keeps a
+  // corrupt count from reserving gigabytes.
+  if (count > (size - *offset) / sizeof(uint32_t)) {
+    return false;
+  }
+  table->reserve(count);
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t length = 0;
+    if (*offset + sizeof(length) > size) {
+      return false;
+    }
+    std::memcpy(&length, data + *offset, sizeof(length));
+    *offset += sizeof(length);
+    if (*offset + length > size) {
+      return false;
+    }
+    table->push_back(std::string(reinterpret_cast<const char*>(data) + *offset, length));
+    *offset += length;
+  }
+  return true;
+}
+
+// Pads data so that it ends on an 8 byte boundary, given that it will
+// be written at offset.
+inline void padToAlignment(QByteArray *data, size_t offset)
+{
+  while ((offset + data->size()) % sizeof(uint64_t) != 0) {
+    data->append('\0');
+  }
+}
+
+template <class T>
+bool writeColumn(QIODevice *device, const std::vector<T> &column)
+{
+  if (column.empty()) {
+    return true;
+  }
+  const qint64 bytes = column.size() * sizeof(T);
+  return device->write(reinterpret_cast<const char*>(&column[0]), bytes) == bytes;
+}
+
+// Returns a pointer to a column of rows values at *offset in a mapped
+// file, and advances *offset past it.
+template <class T>
+const T* mapColumn(const uchar *data, size_t *offset, size_t rows)
+{
+  const T *column = reinterpret_cast<const T*>(data + *offset);
+  *offset += rows * sizeof(T);
+  return column;
+}
+
+// Returns true if every id in the column indexes into table.
+template <class T>
+bool columnIdsValid(const uint32_t *ids, size_t rows, const std::vector<T> &table)
+{
+  for (size_t i = 0; i < rows; i++) {
+    if (ids[i] >= table.size()) {
+      return false;
+    }
+  }
+  return true;
+}
+}  // namespace swri_console
+#endif  // SWRI_CONSOLE_COLUMN_FILE_H_
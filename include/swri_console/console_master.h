@@ -35,16 +35,19 @@
 #include <QObject>
 #include <QList>
 #include <QFont>
+#include <QThread>
 #include <rosgraph_msgs/Log.h>
 #include <swri_console/log_database.h>
 #include <swri_console/bag_reader.h>
+#include <swri_console/log_directory_follower.h>
+#include <swri_console/master_source.h>
+#include <swri_console/text_log_reader.h>
+#include <swri_console/session_journal.h>
 
 #include "ros_thread.h"
 
 namespace swri_console
 {
-typedef std::vector<rosgraph_msgs::LogConstPtr> MessageList;
-
 class ConsoleWindow;
 class ConsoleMaster : public QObject
 {
@@ -58,12 +61,32 @@ class ConsoleMaster : public QObject
   void createNewWindow();
   void fontSelectionChanged(const QFont &font);
   void selectFont();
+  void openSession();
+  void setJournalSession(bool journal);
+  void setSubscribeRosout(bool subscribe);
+  void recoverSession();
+  void followLogDirectory();
+  void addRosMaster();
 
  Q_SIGNALS:
+  void followDirectory(const QString& directory);
+  void stopFollowing();
   void fontChanged(const QFont &font);
 
  private:
   BagReader bag_reader_;
+  TextLogReader text_log_reader_;
+
+  // Follows a ROS log directory on its own thread, as a source of live
+  // messages that doesn't need a master.
+  QThread follow_thread_;
+  LogDirectoryFollower* follower_;
+  QString followed_directory_;
+
+  // Additional ROS masters, each read by its own relay process and
+  // thread.
+  QList<QThread*> source_threads_;
+  QList<MasterSource*> sources_;
 
   // All ROS operations are done on a separate thread to ensure they do not
   // cause the GUI thread to block.
@@ -75,6 +98,10 @@ class ConsoleMaster : public QObject
 
   LogDatabase db_;
 
+  // Live messages are journaled when enabled, so that the session can
+  // be recovered after a crash.
+  SessionJournal journal_;
+
   QFont window_font_;
 };  // class ConsoleMaster
 }  // namespace swri_console
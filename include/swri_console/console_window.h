@@ -36,12 +36,16 @@
 #include <QPushButton>
 #include <QSettings>
 #include "ui_console_window.h"
+#include <swri_console/bag_reader.h>
+#include <swri_console/log_exporter.h>
+#include <swri_console/rosout_deduplicator.h>
 
 namespace swri_console
 {
 class LogDatabase;
 class LogDatabaseProxyModel;
-class NodeListModel;
+class NodeTreeModel;
+class TemplateListModel;
 class ConsoleWindow : public QMainWindow {
   Q_OBJECT
   
@@ -54,15 +58,27 @@ class ConsoleWindow : public QMainWindow {
  Q_SIGNALS:
   void createNewWindow();
   void readBagFile();
+  void readFilteredBagFile(const BagImportFilter &filter);
+  void browseBagFile();
+  void openTextLogs();
+  void followLogDirectory();
+  void addRosMaster();
+  void openSession();
+  void recoverSession();
+  void journalSessionChanged(bool journal);
+  void subscribeRosoutChanged(bool subscribe);
   void selectFont();
                                        
  public Q_SLOTS:
   void clearAll();
   void clearMessages();
   void saveLogs();
+  void saveSelectedLogs();
+  void saveTimeRange();
   void connected(bool);
   void setSeverityFilter();
   void nodeSelectionChanged();
+  void templateSelectionChanged();
   void messagesAdded();
   void showLogContextMenu(const QPoint& point);
   void selectAllLogs();
@@ -70,6 +86,14 @@ class ConsoleWindow : public QMainWindow {
   void copyExtendedLogs();
   void setFollowNewest(bool);
   void toggleAlternateRowColors(bool);
+  void setCollapseRepeats(bool);
+  void promptFilteredBagImport();
+  void selectBodyCacheSize();
+  void selectRateLimit();
+  void selectMemoryBudget();
+  void setJournalSession(bool journal);
+  void setSubscribeRosout(bool subscribe);
+  void showPathStatistics(const RosoutPathStatistics &statistics);
   
   void userScrolled(int);
 
@@ -107,12 +131,25 @@ private:
   };
   void loadColorButtonSetting(const QString& key, QPushButton* button);
   void loadSettings();
+  void updateMemoryUsage();
+  QString promptForExportFile();
 
 
   Ui::ConsoleWindow ui;
   LogDatabase *db_;
   LogDatabaseProxyModel *db_proxy_;
-  NodeListModel *node_list_model_;
+  NodeTreeModel *node_tree_model_;
+  TemplateListModel *template_list_model_;
+  QListView *template_list_;
+  // Shows how many messages /rosout and /rosout_agg lost.
+  QLabel *path_statistics_label_;
+  // Shows the memory used by message text in each tier of the memory
+  // budget.
+  QLabel *memory_usage_label_;
+  // Mirrors the node and severity filters, for filtered bag imports.
+  BagImportFilter import_filter_;
+  // Saves logs in the background.
+  LogExporter exporter_;
 };  // class ConsoleWindow
 }  // namespace swri_console
 
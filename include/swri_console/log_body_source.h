@@ -0,0 +1,68 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_LOG_BODY_SOURCE_H_
+#define SWRI_CONSOLE_LOG_BODY_SOURCE_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include <QStringList>
+
+namespace swri_console
+{
+// Provides the text of log entries that aren't kept in memory.  Each
+// entry stores an opaque locator that the source uses to find its
+// text, e.g. a row in an index file.  Sources are used from the GUI
+// thread and from background exports at the same time, so they must
+// be thread-safe.
+class LogBodySource
+{
+ public:
+  virtual ~LogBodySource() {}
+
+  // Returns the lines of the message at locator, or an empty list if
+  // it can't be read.
+  virtual QStringList text(uint64_t locator) = 0;
+
+  // Fills texts with the lines of the messages at locators first to
+  // first + count - 1, stopping early at the end of the source.
+  // Sources that can read consecutive messages faster than one at a
+  // time should override this.
+  virtual void textRange(uint64_t first, size_t count, std::vector<QStringList> *texts)
+  {
+    texts->clear();
+    for (size_t i = 0; i < count; i++) {
+      texts->push_back(text(first + i));
+    }
+  }
+};
+}  // namespace swri_console
+#endif  // SWRI_CONSOLE_LOG_BODY_SOURCE_H_
@@ -35,21 +35,143 @@
 #include <QAbstractListModel>
 #include <QStringList>
 #include <rosgraph_msgs/Log.h>
-#include <deque>
+#include <QByteArray>
+#include <QCache>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSharedPointer>
+#include <vector>
+#include <boost/unordered_map.hpp>
 #include <ros/time.h>
 
+#include <swri_console/log_body_source.h>
+#include <swri_console/log_store.h>
+#include <swri_console/rosout_message.h>
+#include <swri_console/string_table.h>
+#include <swri_console/tiered_body_source.h>
+
 namespace swri_console
 {
-struct LogEntry
+typedef std::vector<rosgraph_msgs::LogConstPtr> MessageList;
+
+// The name a node on an additional ROS master is shown under, which
+// puts it in the master's namespace, e.g. "/robot2/planner".
+std::string sourceNodeName(const std::string &source_name, const std::string &node_name);
+
+// A message template groups messages that were generated by the same
+// format string.  Templates are derived from the message text by
+// masking out numbers, hex values and file paths.
+struct LogTemplate
+{
+  QString pattern;
+  // Number of messages matching the template, including repeats that
+  // were collapsed into a single entry.
+  size_t count;
+  // Indices of the log entries matching the template, in increasing
+  // order.
+  std::vector<size_t> members;
+};
+
+// Reduces a message to the key of its template.  Messages with the
+// same key belong to the same template.
+QByteArray templateFingerprint(const std::string &text);
+
+// A message whose text is held by a LogBodySource instead of being
+// kept in memory, e.g. one that was loaded from a bag index.
+struct IndexedMessage
 {
   ros::Time stamp;
-  uint8_t level;  
-  std::string node;  
+  uint8_t level;
+  uint32_t seq;
+  std::string node;
   std::string file;
   std::string function;
   uint32_t line;
-  QStringList text;
-  uint32_t seq;
+  uint32_t line_count;
+  QByteArray template_key;
+  // For entries that were saved with repeats collapsed into them.
+  uint32_t repeat_count;
+  ros::Time last_stamp;
+  uint64_t body_locator;
+};
+
+// A batch of indexed messages that share a body source.
+struct IndexedMessageBatch
+{
+  QSharedPointer<LogBodySource> source;
+  std::vector<IndexedMessage> msgs;
+};
+
+// Number of distinct severity levels in rosgraph_msgs::Log.
+static const int SEVERITY_LEVELS = 5;
+
+// Maps a rosgraph_msgs::Log level (DEBUG, INFO, ...) to an index in
+// [0, SEVERITY_LEVELS), or -1 if the level is invalid.
+inline int severityIndex(uint8_t level)
+{
+  switch (level) {
+    case rosgraph_msgs::Log::DEBUG: return 0;
+    case rosgraph_msgs::Log::INFO: return 1;
+    case rosgraph_msgs::Log::WARN: return 2;
+    case rosgraph_msgs::Log::ERROR: return 3;
+    case rosgraph_msgs::Log::FATAL: return 4;
+    default: return -1;
+  }
+}
+
+// Number of messages, in total and broken down by severity.
+struct MessageCounts
+{
+  size_t total;
+  size_t severity[SEVERITY_LEVELS];
+
+  MessageCounts() { clear(); }
+
+  void clear()
+  {
+    total = 0;
+    for (int i = 0; i < SEVERITY_LEVELS; i++) {
+      severity[i] = 0;
+    }
+  }
+
+  void add(uint8_t level, size_t count = 1)
+  {
+    total += count;
+    int index = severityIndex(level);
+    if (index >= 0) {
+      severity[index] += count;
+    }
+  }
+
+  void add(const MessageCounts &other)
+  {
+    total += other.total;
+    for (int i = 0; i < SEVERITY_LEVELS; i++) {
+      severity[i] += other.severity[i];
+    }
+  }
+};
+
+// The memory taken by message text in each tier of the memory budget.
+struct MemoryUsage
+{
+  // Text held by the entries themselves (an estimate).
+  size_t resident_bytes;
+  // Text fetched from body sources and held in the body cache.
+  size_t cached_bytes;
+  size_t compressed_bytes;
+  size_t spilled_bytes;
+  // Entries whose text was dropped.
+  size_t dropped_entries;
+};
+
+// The messages a node added to the database in a single batch
+// (i.e. between two messagesAdded signals).
+struct NodeCountDelta
+{
+  uint32_t node_id;
+  MessageCounts counts;
 };
 
 class LogDatabase : public QObject
@@ -61,24 +183,196 @@ public:
   ~LogDatabase();
   
   void clear();
-  const std::deque<LogEntry>& log() { return log_; }
+  // The committed log entries.  This may only be used from the GUI
+  // thread; other threads should use a snapshot instead.
+  const LogStore& log() const { return *store_; }
+  // Returns a read-only view of the entries committed so far, which
+  // can be handed to other threads.
+  LogSnapshot snapshot() const { return LogSnapshot(store_); }
   const ros::Time& minTime() const { return min_time_; }
 
-  const std::map<std::string, size_t>& messageCounts() const { return msg_counts_; }
+  // Nodes are assigned a small integer id the first time they are
+  // seen.  Ids are never reused or invalidated, even when the
+  // database is cleared.
+  size_t nodeCount() const { return node_names_.size(); }
+  const std::string& nodeName(uint32_t node_id) const { return node_names_[node_id]; }
+  size_t messageCount(uint32_t node_id) const { return msg_counts_[node_id].total; }
+  const MessageCounts& messageCounts(uint32_t node_id) const { return msg_counts_[node_id]; }
+
+  // Messages from additional ROS masters are tagged with a source id.
+  // Source 0 is the local master and any files that were opened.
+  // Every other source has its own node namespace: its nodes are
+  // named "/<source name><node name>", so nodes with the same name on
+  // different masters are kept apart.
+  int addSource(const std::string &name);
+  size_t sourceCount() const { return source_names_.size(); }
+  const std::string& sourceName(int source_id) const { return source_names_[source_id]; }
+  int nodeSource(uint32_t node_id) const { return node_sources_[node_id]; }
+
+  // The nodes that received messages in the latest batch.  This is
+  // only valid while handling the messagesAdded signal.
+  const std::vector<NodeCountDelta>& countDeltas() const { return count_deltas_; }
+
+  size_t fileCount() const { return files_.size(); }
+  const std::string& fileName(uint32_t file_id) const { return files_[file_id]; }
+  size_t functionCount() const { return functions_.size(); }
+  const std::string& functionName(uint32_t function_id) const { return functions_[function_id]; }
+
+  // Returns the lines of an entry's message, fetching them from its
+  // body source if they aren't in memory.
+  QStringList text(const LogEntry &entry) const;
+
+  // The body sources referenced by entries, indexed by their
+  // body_source field.  Entry 0 is always null.
+  const std::vector<QSharedPointer<LogBodySource> >& bodySources() const { return body_sources_; }
+
+  // Sets the memory budget for text fetched from body sources.  While
+  // a memory budget is set, the cache is limited to a quarter of it.
+  void setBodyCacheSize(int megabytes);
+
+  size_t templateCount() const { return templates_.size(); }
+  const LogTemplate& logTemplate(uint32_t id) const { return templates_[id]; }
+
+  bool collapseRepeats() const { return collapse_repeats_; }
+  void setCollapseRepeats(bool collapse);
+
+  // Limits the rate of live messages each node can add, in messages
+  // per second, or 0 for no limit.  Messages at WARN and above are
+  // always kept; above the limit, lower severities are sampled with a
+  // token bucket per node.  Dropped messages still count towards the
+  // node's message counts, and are summed up in an entry added about
+  // once a second while a node is being limited.
+  int rateLimit() const { return rate_limit_; }
+  void setRateLimit(int messages_per_second);
+
+  // Limits the memory used by message text, or 0 for no limit.  Text
+  // beyond the limit is degraded a chunk at a time, oldest first:
+  // chunks are compressed in memory, then compressed chunks are
+  // spilled to a temporary directory, which is in turn limited to
+  // disk_megabytes, and the oldest spilled chunks are dropped.  The
+  // entries themselves stay in memory, so counts and filters other
+  // than the text filters are unaffected.  Text held in the body
+  // cache counts against the memory budget.
+  void setMemoryBudget(int memory_megabytes, int disk_megabytes);
+  size_t memoryBudget() const { return memory_budget_; }
+  MemoryUsage memoryUsage() const;
 
  Q_SIGNALS:
   void databaseCleared();
   void messagesAdded();
+  // Emitted when entries that were already added have been modified
+  // (e.g. their repeat count was incremented).
+  void messagesUpdated();
   void minTimeUpdated();
 
 public Q_SLOTS:
-  void queueMessage(const rosgraph_msgs::LogConstPtr msg);
+  void queueMessages(const MessageList &msgs);
+  // Like queueMessages(), but for messages that are arriving as they
+  // are logged (e.g. from a followed log directory), so they are
+  // admitted the same way as live rosout messages.
+  void queueLiveMessages(const MessageList &msgs);
+  void queueRosoutMessages(const RosoutMessageList &msgs);
+  void queueSourceMessages(int source_id, const RosoutMessageList &msgs);
+  void queueIndexedMessages(const IndexedMessageBatch &batch);
   void processQueue();
 
 private:  
-  std::map<std::string, size_t> msg_counts_;
-  std::deque<LogEntry> log_;
-  std::deque<LogEntry> new_msgs_;
+  // Adds a rosgraph_msgs::Log or a RosoutMessage.  Live messages are
+  // subject to the rate limit.
+  template <class Message>
+  void addMessage(const Message &msg, int source_id, bool live);
+  bool admitMessage(uint32_t node_id, uint8_t level, const ros::Time &stamp);
+  void addDropSummaries(bool flush_all);
+  void addResidentText(size_t index, const QStringList &text);
+  void enforceMemoryBudget();
+  // Sets the body cache's max cost from its size and the memory budget.
+  void updateBodyCacheCost();
+  void compressChunk(size_t chunk);
+  bool collapseRepeat(uint32_t node_id,
+                      uint8_t level,
+                      uint32_t line,
+                      uint32_t file_id,
+                      const QStringList &text,
+                      const ros::Time &stamp);
+  uint32_t addToTemplate(const QByteArray &fingerprint, size_t index);
+  uint32_t nodeId(const std::string &name, int source_id);
+  void countMessage(uint32_t node_id, const ros::Time &stamp, uint8_t level,
+                    size_t count = 1);
+  uint32_t bodySourceId(const QSharedPointer<LogBodySource> &source);
+
+  // Node ids by name, indexed by source id.
+  std::vector<boost::unordered_map<std::string, uint32_t> > node_ids_;
+  std::vector<std::string> node_names_;
+  std::vector<int> node_sources_;
+  std::vector<std::string> source_names_;
+  std::vector<MessageCounts> msg_counts_;
+
+  StringTable files_;
+  StringTable functions_;
+
+  // Body sources referenced by the entries in the store.  Body source
+  // 0 is reserved for entries whose text is in memory.
+  std::vector<QSharedPointer<LogBodySource> > body_sources_;
+
+  // Text fetched from body sources is cached in pages of consecutive
+  // locators, keyed by source id and page number.  QCache evicts the
+  // least recently used pages once the budget (in kB) is exceeded.
+  typedef std::vector<QStringList> BodyPage;
+  mutable QCache<quint64, BodyPage> body_cache_;
+  // The body cache size requested with setBodyCacheSize().
+  int body_cache_mb_;
+
+  // Per-node message counts for the batch that is currently being
+  // queued, and the nodes that have a non-zero count.
+  std::vector<MessageCounts> batch_counts_;
+  std::vector<uint32_t> batch_nodes_;
+  std::vector<NodeCountDelta> count_deltas_;
+
+  // Queued messages are appended to the store right away, and
+  // committed when the queue is processed.
+  QSharedPointer<LogStore> store_;
+
+  bool collapse_repeats_;
+  bool entries_updated_;
+  // Index of the most recent entry from each node, indexed by node
+  // id.
+  std::vector<size_t> last_entry_;
+
+  std::vector<LogTemplate> templates_;
+  QHash<QByteArray, uint32_t> template_ids_;
+
+  // The token bucket of each node, indexed by node id, and the
+  // messages it dropped since the last summary.
+  struct RateGovernor
+  {
+    double tokens;
+    qint64 refill_time;
+    MessageCounts dropped;
+    ros::Time first_dropped;
+    ros::Time last_dropped;
+    qint64 summary_time;
+  };
+  int rate_limit_;
+  std::vector<RateGovernor> governors_;
+  // Nodes with dropped messages that haven't been summed up yet.
+  std::vector<uint32_t> dropping_nodes_;
+  QElapsedTimer clock_;
+
+  // The memory budget, in bytes.
+  size_t memory_budget_;
+  size_t disk_budget_;
+  // The estimated size of the text held by the entries of each chunk,
+  // and in total.
+  std::vector<size_t> chunk_text_bytes_;
+  size_t resident_bytes_;
+  // Chunks are degraded oldest first, so the chunks in each tier form
+  // a range: [0, dropped_chunks_) are dropped, up to spilled_chunks_
+  // are spilled (or dropped, if they couldn't be spilled), and up to
+  // compressed_chunks_ are compressed.
+  size_t compressed_chunks_;
+  size_t spilled_chunks_;
+  size_t dropped_chunks_;
+  QSharedPointer<TieredBodySource> tiered_source_;
 
   ros::Time min_time_;
 };  // class LogDatabase
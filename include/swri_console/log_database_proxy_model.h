@@ -32,14 +32,20 @@
 #define SWRI_CONSOLE_LOG_DATABASE_PROXY_MODEL_H_
 
 #include <QAbstractListModel>
+#include <QItemSelection>
 #include <QColor>
 #include <QStringList>
 #include <QRegExp>
 
+#include <ros/time.h>
+
 #include <stdint.h>
 #include <set>
 #include <string>
 #include <deque>
+#include <vector>
+
+#include <swri_console/log_exporter.h>
 
 namespace swri_console
 {
@@ -58,7 +64,11 @@ class LogDatabaseProxyModel : public QAbstractListModel
   LogDatabaseProxyModel(LogDatabase *db);
   ~LogDatabaseProxyModel();
 
-  void setNodeFilter(const std::set<std::string> &names);
+  // Accept messages from the nodes in names, and from any node whose
+  // name starts with one of the prefixes.
+  void setNodeFilter(const std::set<std::string> &names,
+                     const std::set<std::string> &prefixes);
+  void setTemplateFilter(const std::set<uint32_t> &template_ids);
   void setSeverityFilter(uint8_t severity_mask);
   void setIncludeFilters(const QStringList &list);
   void setExcludeFilters(const QStringList &list);
@@ -76,16 +86,30 @@ class LogDatabaseProxyModel : public QAbstractListModel
 
   virtual int rowCount(const QModelIndex &parent) const;
   virtual QVariant data(const QModelIndex &index, int role) const;
+  // The stamp of the message shown in a row.
+  ros::Time rowStamp(int row) const;
 
   void reset();
 
-  void saveToFile(const QString& filename) const;
+  // Captures the entries that pass the filters, along with everything
+  // needed to write them to filename in the background.  The format is
+  // picked from the file's extension.
+  LogExportJob exportJob(const QString& filename) const;
+  // Like exportJob, but only entries stamped between begin and end
+  // (inclusive).
+  LogExportJob exportJob(const QString& filename,
+                         const ros::Time& begin,
+                         const ros::Time& end) const;
+  // Like exportJob, but only the entries with a line in selection.
+  LogExportJob exportJob(const QString& filename,
+                         const QItemSelection& selection) const;
 
  Q_SIGNALS:
   void messagesAdded();
 
  public Q_SLOTS:
   void handleDatabaseCleared();
+  void handleMessagesUpdated();
   void processNewMessages();
   void processOldMessages();
   void minTimeUpdated();
@@ -95,14 +119,23 @@ class LogDatabaseProxyModel : public QAbstractListModel
   void setUseRegularExpressions(bool useRegexps);
 
  private:
-  void saveBagFile(const QString& filename) const;
-  void saveTextFile(const QString& filename) const;
   void scheduleIdleProcessing();
+  LogExportJob makeExportJob(const QString& filename,
+                             std::vector<size_t>* entries) const;
   
   bool acceptLogEntry(const LogEntry &item);
+  bool acceptNode(uint32_t node_id);
   bool testIncludeFilter(const LogEntry &item);
   
   std::set<std::string> names_;
+  std::set<std::string> prefixes_;
+  // Caches the result of the node filter for each node id, so that
+  // entries can be tested without any string comparisons.
+  enum NodeFilterResult { NODE_UNKNOWN = 0, NODE_ACCEPTED, NODE_REJECTED };
+  std::vector<uint8_t> node_filter_;
+  // When non-empty, only entries matching one of these templates are
+  // accepted.
+  std::set<uint32_t> template_ids_;
   uint8_t severity_mask_;
   bool colorize_logs_;
   bool display_time_;
@@ -120,6 +153,11 @@ class LogDatabaseProxyModel : public QAbstractListModel
     LineMap() : log_index(0), line_index(0) {}
     LineMap(size_t log, int line) : log_index(log), line_index(line) {}
   };
+  // Rows are always ordered by log index.
+  static bool lineMapLess(const LineMap &a, const LineMap &b)
+  {
+    return a.log_index < b.log_index;
+  }
   
   size_t latest_log_index_;
   std::deque<LineMap> msg_mapping_;
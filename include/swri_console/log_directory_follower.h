@@ -0,0 +1,138 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_LOG_DIRECTORY_FOLLOWER_H
+#define SWRI_CONSOLE_LOG_DIRECTORY_FOLLOWER_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QString>
+
+#include <rosgraph_msgs/Log.h>
+#include <swri_console/log_database.h>
+
+class QFileSystemWatcher;
+class QTimer;
+
+namespace swri_console
+{
+  /**
+   * Follows the text logs that ROS nodes write to a log directory
+   * (e.g. ~/.ros/log/latest), so that messages can be watched without a
+   * ROS master.
+   *
+   * The directory and its log files are watched with QFileSystemWatcher,
+   * which uses inotify on Linux.  The offset read so far is remembered
+   * for every file, so each change only reads the data appended since
+   * the last one; new files are picked up as they appear and truncated
+   * files are read again from the start.  Lines are parsed with the
+   * same parser as TextLogReader.
+   *
+   * The same message often ends up in more than one file (e.g. a node's
+   * own log and rosout.log), so recently seen messages are remembered
+   * and only delivered once.
+   *
+   * The follower is meant to be moved to its own thread; its slots are
+   * invoked through queued connections.
+   */
+  class LogDirectoryFollower : public QObject
+  {
+    Q_OBJECT
+  public:
+    LogDirectoryFollower();
+
+  public Q_SLOTS:
+    /**
+     * Starts following a directory, after reading the existing contents
+     * of its log files.  Stops following any previous directory.
+     */
+    void follow(const QString& directory);
+
+    /**
+     * Stops following the current directory.
+     */
+    void stop();
+
+  Q_SIGNALS:
+    /**
+     * Emitted with the messages read after each change.
+     */
+    void messagesRead(const MessageList& msgs);
+
+  private Q_SLOTS:
+    void handleDirectoryChanged(const QString& path);
+    void handleFileChanged(const QString& path);
+    void flushPending();
+
+  private:
+    struct FileState
+    {
+      FileState() : id(0), offset(0), seq(0), changed_ms(0) {}
+
+      // Identifies the file in seen_.
+      uint32_t id;
+      qint64 offset;
+      std::string node;
+      uint32_t seq;
+      // The last message read from the file.  It is held back until the
+      // next message starts, since more lines of it may still be on the
+      // way.
+      rosgraph_msgs::LogPtr pending;
+      // When the file last changed, on clock_.
+      qint64 changed_ms;
+    };
+
+    void scanDirectory();
+    void readFile(const QString& path, MessageList* msgs);
+    void flushFiles(bool all);
+    void startFlushTimer();
+    void deliver(const rosgraph_msgs::LogPtr& log, uint32_t file_id, MessageList* msgs);
+
+    QString directory_;
+    QFileSystemWatcher* watcher_;
+    QTimer* flush_timer_;
+    QElapsedTimer clock_;
+    QHash<QString, FileState> files_;
+    uint32_t next_file_id_;
+
+    // Keys of the messages delivered recently and the file each came
+    // from, with the keys in order, oldest first.
+    QHash<quint64, uint32_t> seen_;
+    std::deque<quint64> seen_order_;
+  };
+}
+
+#endif //SWRI_CONSOLE_LOG_DIRECTORY_FOLLOWER_H
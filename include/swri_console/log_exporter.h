@@ -0,0 +1,196 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_LOG_EXPORTER_H
+#define SWRI_CONSOLE_LOG_EXPORTER_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QThread>
+
+#include <ros/time.h>
+#include <swri_console/log_body_source.h>
+#include <swri_console/log_store.h>
+
+class QProgressDialog;
+
+namespace swri_console
+{
+  /**
+   * Writes the prefix that is displayed before the first line of a
+   * message, e.g. "[W 0:01:02:345] ", to buffer.  Relative times are
+   * measured from min_time.  Returns the length of the prefix.
+   */
+  int formatLogHeader(char* buffer, size_t size,
+                      uint8_t level,
+                      const ros::Time& stamp,
+                      const ros::Time& min_time,
+                      bool display_time,
+                      bool absolute_time);
+
+  /**
+   * Everything an export needs from the database.  The job is filled in
+   * on the GUI thread and only refers to a snapshot of the log, so the
+   * export can run in the background while new messages keep arriving
+   * or the database is cleared.
+   */
+  struct LogExportJob
+  {
+    enum Format
+    {
+      BAG,
+      SESSION,
+      TEXT,
+      // One JSON object per entry, with every field.
+      JSON_LINES,
+      // One row per entry, with every field.
+      CSV
+    };
+
+    LogExportJob() :
+      format(TEXT),
+      compress(false),
+      display_time(true),
+      absolute_time(false)
+    {}
+
+    QString filename;
+    Format format;
+    // Text, JSON and CSV files can be gzip compressed as they are
+    // written.
+    bool compress;
+
+    LogSnapshot log;
+    // Indices in log of the entries to export, in order.
+    std::vector<size_t> entries;
+    // The repeat count and last stamp of each entry, which are copied
+    // because the database keeps updating them as repeats arrive.
+    std::vector<uint32_t> repeat_counts;
+    std::vector<ros::Time> last_stamps;
+
+    // Copies of the database's tables, indexed by the ids stored in the
+    // entries.
+    std::vector<std::string> node_names;
+    std::vector<std::string> file_names;
+    std::vector<std::string> function_names;
+    std::vector<QString> template_patterns;
+    std::vector<QSharedPointer<LogBodySource> > body_sources;
+
+    // Text exports are formatted the same way as the display.
+    bool display_time;
+    bool absolute_time;
+    ros::Time min_time;
+  };
+
+  /**
+   * Writes the entries of an export job to a file on a background thread.
+   */
+  class LogExportThread : public QThread
+  {
+    Q_OBJECT
+  public:
+    explicit LogExportThread(const LogExportJob& job);
+
+    /**
+     * Asks the thread to stop.  A cancelled export leaves no file behind
+     * (or the previous file untouched, for session and text files).
+     */
+    void cancel();
+
+    bool wasCancelled() const { return cancelled_; }
+    const QString& errorString() const { return error_; }
+
+  Q_SIGNALS:
+    /**
+     * Emitted as entries are written, with progress between 0 and 1000.
+     */
+    void progress(int permille);
+
+  protected:
+    void run();
+
+  private:
+    void writeBagFile();
+    void writeSessionFile();
+    void writeFormattedFile();
+    void appendText(QByteArray* buffer, size_t index, const LogEntry& item, const QStringList& lines);
+    void appendJson(QByteArray* buffer, size_t index, const LogEntry& item, const QStringList& lines);
+    void appendCsv(QByteArray* buffer, size_t index, const LogEntry& item, const QStringList& lines);
+
+    const QStringList& text(const LogEntry& entry);
+    void reportProgress(size_t done);
+
+    LogExportJob job_;
+    QString error_;
+    volatile bool cancelled_;
+    int last_progress_;
+
+    // Text that isn't in memory is fetched from its body source in
+    // pages of consecutive locators.
+    uint32_t page_source_;
+    uint64_t page_first_;
+    std::vector<QStringList> page_;
+    QStringList padded_text_;
+  };
+
+  /**
+   * Runs exports in the background and shows their progress.  Only one
+   * export runs at a time.
+   */
+  class LogExporter : public QObject
+  {
+    Q_OBJECT
+  public:
+    LogExporter();
+    ~LogExporter();
+
+    /**
+     * Starts writing the job's entries to its file.  Returns false if an
+     * export is already running.
+     */
+    bool exportLogs(const LogExportJob& job);
+
+  private Q_SLOTS:
+    void cancelExport();
+    void handleThreadFinished();
+
+  private:
+    LogExportThread* thread_;
+    QProgressDialog* progress_dialog_;
+  };
+}
+
+#endif //SWRI_CONSOLE_LOG_EXPORTER_H
@@ -0,0 +1,193 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_LOG_STORE_H_
+#define SWRI_CONSOLE_LOG_STORE_H_
+
+#include <stdint.h>
+
+#include <utility>
+#include <vector>
+
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <QStringList>
+
+#include <ros/time.h>
+
+namespace swri_console
+{
+struct LogEntry
+{
+  ros::Time stamp;
+  uint8_t level;  
+  uint32_t node_id;
+  // File and function names are interned by the database.
+  uint32_t file_id;
+  uint32_t function_id;
+  uint32_t line;
+  uint32_t seq;
+
+  // The message text, split into lines.  The text of entries loaded
+  // from an index isn't kept in memory; for those, text is empty and
+  // the database fetches it from body source body_source using
+  // body_locator.  line_count is valid either way.
+  QStringList text;
+  uint32_t line_count;
+  uint32_t body_source;
+  uint64_t body_locator;
+
+  // When repeat collapsing is enabled, a run of identical messages
+  // from the same node is folded into a single entry.  repeat_count
+  // is the number of messages in the run (1 for a normal entry) and
+  // last_stamp is the timestamp of the most recent one.
+  uint32_t repeat_count;
+  ros::Time last_stamp;
+
+  // Index of the message template this entry belongs to.
+  uint32_t template_id;
+};
+
+// Append-only storage for log entries.
+//
+// Entries are stored in fixed-size chunks that are never moved or
+// reallocated, so a reference to an entry stays valid for the life
+// of the store.  A single writer appends entries and then commits
+// them, which atomically publishes the new size.  Any number of
+// readers on other threads may access the committed entries without
+// locking while the writer keeps appending.
+//
+// The only fields that change after an entry is committed are
+// repeat_count and last_stamp, which are updated when a repeated
+// message is collapsed into the entry.  Readers on other threads must
+// not read them; the writer's thread copies them for anyone who needs
+// them (e.g. an export job).  The writer may also move an entry's
+// text to a body source (text, body_source and body_locator), but
+// only while there are no snapshots of the store.
+class LogStore
+{
+ public:
+  LogStore();
+  ~LogStore();
+
+  // The number of committed entries.  Safe to call from any thread.
+  size_t size() const { return committed_.loadAcquire(); }
+
+  // Safe to call from any thread for indices less than size().
+  const LogEntry& operator[](size_t index) const
+  {
+    return chunks_[index >> CHUNK_BITS][index & CHUNK_MASK];
+  }
+
+  // The remaining methods may only be called by the writer.
+
+  // The number of entries including those that aren't committed yet.
+  size_t appendedSize() const { return appended_; }
+  LogEntry& entry(size_t index)
+  {
+    return chunks_[index >> CHUNK_BITS][index & CHUNK_MASK];
+  }
+  // Returns false if the store is full.
+  bool append(const LogEntry &entry);
+  // Publishes all appended entries to readers.
+  void commit() { committed_.storeRelease(appended_); }
+
+  // Entries are grouped into chunks of chunkSize() consecutive
+  // indices.  The earliest and latest stamp in each chunk are tracked
+  // as entries are appended, so that time range queries can skip
+  // chunks without looking at their entries.
+  static size_t chunkSize() { return CHUNK_SIZE; }
+  size_t chunkCount() const { return chunk_stamps_.size(); }
+  const ros::Time& chunkMinStamp(size_t chunk) const { return chunk_stamps_[chunk].first; }
+  const ros::Time& chunkMaxStamp(size_t chunk) const { return chunk_stamps_[chunk].second; }
+
+  // The number of snapshots of the store that currently exist.
+  int snapshotCount() const { return snapshots_.load(); }
+
+ private:
+  // Disable copying.
+  LogStore(const LogStore&);
+  LogStore& operator=(const LogStore&);
+
+  // 2^14 entries per chunk and 2^16 chunks gives room for about a
+  // billion entries, while the chunk directory only takes 512 kB.
+  static const size_t CHUNK_BITS = 14;
+  static const size_t CHUNK_SIZE = 1 << CHUNK_BITS;
+  static const size_t CHUNK_MASK = CHUNK_SIZE - 1;
+  static const size_t MAX_CHUNKS = 1 << 16;
+
+  // Allocated once with room for MAX_CHUNKS, so that readers never
+  // see it move.
+  LogEntry **chunks_;
+  size_t appended_;
+  QAtomicInt committed_;
+
+  // The earliest and latest stamp in each allocated chunk.
+  std::vector<std::pair<ros::Time, ros::Time> > chunk_stamps_;
+
+  mutable QAtomicInt snapshots_;
+  friend class LogSnapshot;
+};
+
+// A read-only view of the first size() entries of a LogStore.
+// Snapshots are cheap to copy and may be used from any thread; they
+// keep the store alive even if the database is cleared in the
+// meantime.
+class LogSnapshot
+{
+ public:
+  LogSnapshot() : size_(0) {}
+  LogSnapshot(const QSharedPointer<const LogStore> &store)
+    : store_(store), size_(store->size()) { store_->snapshots_.ref(); }
+  LogSnapshot(const LogSnapshot &other)
+    : store_(other.store_), size_(other.size_) { if (store_) { store_->snapshots_.ref(); } }
+  ~LogSnapshot() { if (store_) { store_->snapshots_.deref(); } }
+  LogSnapshot& operator=(const LogSnapshot &other)
+  {
+    if (other.store_) {
+      other.store_->snapshots_.ref();
+    }
+    if (store_) {
+      store_->snapshots_.deref();
+    }
+    store_ = other.store_;
+    size_ = other.size_;
+    return *this;
+  }
+
+  size_t size() const { return size_; }
+  const LogEntry& operator[](size_t index) const { return (*store_)[index]; }
+
+ private:
+  QSharedPointer<const LogStore> store_;
+  size_t size_;
+};
+}  // namespace swri_console
+#endif  // SWRI_CONSOLE_LOG_STORE_H_
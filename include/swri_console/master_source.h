@@ -0,0 +1,118 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_MASTER_SOURCE_H
+#define SWRI_CONSOLE_MASTER_SOURCE_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QProcess>
+#include <QString>
+
+#include <swri_console/rosout_message.h>
+
+class QTimer;
+
+namespace swri_console
+{
+  /**
+   * Receives the log messages of an additional ROS master.
+   *
+   * roscpp only talks to one master per process, so each additional
+   * master is served by a relay: a child process running this executable
+   * with RELAY_ARGUMENT and ROS_MASTER_URI pointing at the master.  The
+   * relay subscribes to /rosout_agg and writes each message to its
+   * standard output, serialized and prefixed with its length; the source
+   * reads them back and delivers them in batches.
+   *
+   * A source is meant to be moved to its own thread, so that a source
+   * that is slow or flooded with messages doesn't hold up the others.
+   * Its slots are invoked through queued connections.
+   *
+   * If the relay crashes, it is restarted after a delay that doubles
+   * with each crash until the relay delivers messages again.
+   */
+  class MasterSource : public QObject
+  {
+    Q_OBJECT
+  public:
+    /**
+     * The command line argument that runs the executable as a relay.
+     */
+    static const char* const RELAY_ARGUMENT;
+
+    /**
+     * source_id identifies the source in the LogDatabase, and is passed
+     * along with the messages.
+     */
+    MasterSource(int source_id, const QString& master_uri);
+    ~MasterSource();
+
+    /**
+     * Runs the relay and returns its exit code.  This is called from
+     * main() when the executable was started with RELAY_ARGUMENT.
+     */
+    static int runRelay(int argc, char** argv);
+
+  public Q_SLOTS:
+    /**
+     * Starts the relay process.
+     */
+    void start();
+
+    /**
+     * Stops the relay process.
+     */
+    void stop();
+
+  Q_SIGNALS:
+    /**
+     * Emitted with the messages read from the relay each time its output
+     * becomes readable.
+     */
+    void logsReceived(int source_id, const RosoutMessageList& msgs);
+
+  private Q_SLOTS:
+    void readMessages();
+    void handleError(QProcess::ProcessError error);
+
+  private:
+    int source_id_;
+    QString master_uri_;
+    QProcess* relay_;
+    // Restarts the relay after it crashed.
+    QTimer* restart_timer_;
+    int restart_delay_ms_;
+    // Output of the relay that doesn't make up a complete message yet.
+    QByteArray buffer_;
+  };
+}
+
+#endif //SWRI_CONSOLE_MASTER_SOURCE_H
@@ -0,0 +1,99 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_NODE_TREE_MODEL_H_
+#define SWRI_CONSOLE_NODE_TREE_MODEL_H_
+
+#include <stdint.h>
+#include <set>
+#include <string>
+#include <vector>
+#include <QAbstractItemModel>
+
+namespace swri_console
+{
+class LogDatabase;
+struct MessageCounts;
+
+// Presents the nodes in the log database as a tree of ROS
+// namespaces.  Every item displays the number of messages received
+// by the nodes beneath it, and the counts are rolled up incrementally
+// as new messages arrive.
+class NodeTreeModel : public QAbstractItemModel
+{
+  Q_OBJECT
+  
+ public:
+  NodeTreeModel(LogDatabase* db);
+  ~NodeTreeModel();
+
+  // Adds the item at index to a node filter.  Nodes are added to
+  // names, and namespaces are added to prefixes so that they match
+  // every node beneath them, including nodes that appear later.
+  void addToFilter(const QModelIndex &index,
+                   std::set<std::string> *names,
+                   std::set<std::string> *prefixes) const;
+
+  // The last segment of the item's name.  Namespaces end with a '/'.
+  QString shortName(const QModelIndex &index) const;
+
+  virtual QModelIndex index(int row, int column,
+                            const QModelIndex &parent = QModelIndex()) const;
+  virtual QModelIndex parent(const QModelIndex &index) const;
+  virtual int rowCount(const QModelIndex &parent = QModelIndex()) const;
+  virtual int columnCount(const QModelIndex &parent = QModelIndex()) const;
+  virtual QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+ public Q_SLOTS:
+  void clear();
+                                                                 
+ private Q_SLOTS:
+  void handleDatabaseCleared();
+  void handleMessagesAdded();
+  
+ private:
+  struct Item;
+  static bool segmentLess(const Item *item, const std::string &segment);
+
+  void addNode(uint32_t node_id);
+  void addCounts(Item *item, const MessageCounts &counts);
+  void clearCounts(Item *item);
+  QModelIndex indexFromItem(Item *item) const;
+  Item* itemFromIndex(const QModelIndex &index) const;
+
+  LogDatabase *db_;
+
+  Item *root_;
+  // The item for each node, indexed by node id.  NULL if the node
+  // isn't in the tree.
+  std::vector<Item*> node_items_;
+};
+}  // namespace swri_console
+#endif  // SWRI_CONSOLE_NODE_TREE_MODEL_H_
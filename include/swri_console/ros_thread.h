@@ -36,6 +36,8 @@
 #include <ros/ros.h>
 #include <rosgraph_msgs/Log.h>
 #include <QMetaType>
+#include <swri_console/rosout_deduplicator.h>
+#include <swri_console/rosout_message.h>
 
 namespace swri_console
 {
@@ -49,32 +51,54 @@ namespace swri_console
      */
     void shutdown();
 
+    /**
+     * Sets whether to subscribe to /rosout in addition to /rosout_agg.
+     * Messages are then delivered as soon as the first of their two
+     * copies arrives, and pathStatistics() is emitted periodically.
+     * This is safe to call from any thread.
+     */
+    void setSubscribeRosout(bool subscribe);
+
   Q_SIGNALS:
     /**
      * Emitted every time we are successfully connected to or disconnected from ROS.
      */
     void connected(bool);
     /**
-     * Emitted every time a log message is received.  This can be emitted multiple times per spin of
-     * the ROS core; wait until spun() is emitted to do any processing on them.
+     * Emitted with the log messages received during a spin of the ROS core, if there were any.
+     * This is emitted before spun().
      */
-    void logReceived(const rosgraph_msgs::LogConstPtr &msg);
+    void logsReceived(const RosoutMessageList &msgs);
     /**
      * Emitted after every time ros::spinOnce() completes.
      */
     void spun();
+    /**
+     * Emitted about once a second while subscribed to /rosout, with
+     * the statistics of both paths since the subscription started.
+     */
+    void pathStatistics(const RosoutPathStatistics &statistics);
 
   protected:
     void run();
 
   private:
-    void handleRosout(const rosgraph_msgs::LogConstPtr &msg);
+    void handleRosout(const RosoutMessageConstPtr &msg);
+    void handleDirectRosout(const RosoutMessageConstPtr &msg);
+    void updateRosoutSubscription();
     void startRos();
     void stopRos();
 
     bool is_connected_;
     volatile bool is_running_;
     ros::Subscriber rosout_sub_;
+    volatile bool subscribe_rosout_;
+    ros::Subscriber direct_rosout_sub_;
+    RosoutDeduplicator deduplicator_;
+    ros::WallTime statistics_time_;
+    // Messages received during the current spin.  Emitting them in one
+    // batch per spin is much cheaper than a queued signal per message.
+    RosoutMessageList received_;
   };
 }
 
@@ -0,0 +1,133 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_ROSOUT_DEDUPLICATOR_H
+#define SWRI_CONSOLE_ROSOUT_DEDUPLICATOR_H
+
+#include <stdint.h>
+
+#include <deque>
+
+#include <boost/unordered_map.hpp>
+
+#include <swri_console/rosout_message.h>
+
+namespace swri_console
+{
+  /**
+   * The paths a message can take from a node to the console.  /rosout
+   * comes straight from the node, /rosout_agg is republished by rosout.
+   */
+  enum RosoutPath
+  {
+    ROSOUT_DIRECT = 0,
+    ROSOUT_AGGREGATED = 1,
+    ROSOUT_PATH_COUNT = 2
+  };
+
+  /**
+   * Statistics on the messages received over each path.
+   */
+  struct RosoutPathStatistics
+  {
+    RosoutPathStatistics()
+    {
+      for (int i = 0; i < ROSOUT_PATH_COUNT; i++) {
+        received[i] = 0;
+        first[i] = 0;
+        lost[i] = 0;
+      }
+    }
+
+    // Copies received over the path.
+    uint64_t received[ROSOUT_PATH_COUNT];
+    // Messages whose copy from this path arrived before the other one.
+    uint64_t first[ROSOUT_PATH_COUNT];
+    // Messages that arrived over the other path, but not over this one
+    // within a few seconds.
+    uint64_t lost[ROSOUT_PATH_COUNT];
+  };
+
+  /**
+   * Merges the messages received over /rosout and /rosout_agg, so that
+   * each one is delivered only once, as soon as its first copy arrives.
+   *
+   * Messages are identified by their node, timestamp and text.  The
+   * header's seq can't be used on its own, since every publisher
+   * numbers the messages it sends, including rosout when it republishes
+   * them.  A message is remembered for a few seconds after its first
+   * copy arrives; if the second copy hasn't arrived by then, it is
+   * counted as lost on the other path.  At most WINDOW_SIZE messages are
+   * remembered, to bound memory when messages arrive very quickly.
+   */
+  class RosoutDeduplicator
+  {
+  public:
+    RosoutDeduplicator();
+
+    /**
+     * Returns true if this is the first copy of the message.
+     */
+    bool add(const RosoutMessage& msg, RosoutPath path);
+
+    /**
+     * Forgets the messages whose second copy is overdue and counts
+     * them as lost.  add() also does this, but it should be called
+     * periodically so that losses are counted when no messages arrive.
+     */
+    void expire();
+
+    /**
+     * Forgets all messages and resets the statistics.
+     */
+    void clear();
+
+    const RosoutPathStatistics& statistics() const { return statistics_; }
+
+  private:
+    struct Arrival
+    {
+      size_t key;
+      ros::WallTime time;
+    };
+
+    void expire(const ros::WallTime& now);
+    void forgetOldest(bool count_lost);
+
+    // The paths each remembered message has been received on, as a bit
+    // mask, and the messages in the order they were first received.
+    boost::unordered_map<size_t, uint8_t> paths_;
+    std::deque<Arrival> order_;
+
+    RosoutPathStatistics statistics_;
+  };
+}
+
+#endif //SWRI_CONSOLE_ROSOUT_DEDUPLICATOR_H
@@ -0,0 +1,167 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_ROSOUT_MESSAGE_H_
+#define SWRI_CONSOLE_ROSOUT_MESSAGE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <ros/serialization.h>
+#include <ros/time.h>
+#include <rosgraph_msgs/Log.h>
+
+namespace swri_console
+{
+// A rosgraph_msgs/Log message, reduced to the fields the console uses.
+//
+// Live messages are subscribed to as this type instead of
+// rosgraph_msgs::Log.  It has the same wire format and MD5 sum, but its
+// deserializer skips the header's frame_id and the topics array instead
+// of allocating a string for every entry, so the only allocations per
+// message are for the strings the database actually stores.  The field
+// names match rosgraph_msgs::Log, so the database can ingest either.
+struct RosoutMessage
+{
+  struct Header
+  {
+    Header() : seq(0) {}
+
+    uint32_t seq;
+    ros::Time stamp;
+  };
+
+  RosoutMessage() : level(0), line(0) {}
+
+  Header header;
+  uint8_t level;
+  std::string name;
+  std::string msg;
+  std::string file;
+  std::string function;
+  uint32_t line;
+};
+
+typedef boost::shared_ptr<RosoutMessage> RosoutMessagePtr;
+typedef boost::shared_ptr<const RosoutMessage> RosoutMessageConstPtr;
+typedef std::vector<RosoutMessageConstPtr> RosoutMessageList;
+}  // namespace swri_console
+
+namespace ros
+{
+namespace message_traits
+{
+template<> struct MD5Sum<swri_console::RosoutMessage>
+{
+  static const char* value() { return MD5Sum<rosgraph_msgs::Log>::value(); }
+  static const char* value(const swri_console::RosoutMessage&) { return value(); }
+};
+
+template<> struct DataType<swri_console::RosoutMessage>
+{
+  static const char* value() { return DataType<rosgraph_msgs::Log>::value(); }
+  static const char* value(const swri_console::RosoutMessage&) { return value(); }
+};
+
+template<> struct Definition<swri_console::RosoutMessage>
+{
+  static const char* value() { return Definition<rosgraph_msgs::Log>::value(); }
+  static const char* value(const swri_console::RosoutMessage&) { return value(); }
+};
+}  // namespace message_traits
+
+namespace serialization
+{
+template<> struct Serializer<swri_console::RosoutMessage>
+{
+  // Written with an empty frame_id and topics, so that the result can
+  // be read back as a rosgraph_msgs::Log.
+  template<typename Stream>
+  inline static void write(Stream& stream, const swri_console::RosoutMessage& m)
+  {
+    stream.next(m.header.seq);
+    stream.next(m.header.stamp);
+    stream.next(static_cast<uint32_t>(0));
+    stream.next(m.level);
+    stream.next(m.name);
+    stream.next(m.msg);
+    stream.next(m.file);
+    stream.next(m.function);
+    stream.next(m.line);
+    stream.next(static_cast<uint32_t>(0));
+  }
+
+  template<typename Stream>
+  inline static void read(Stream& stream, swri_console::RosoutMessage& m)
+  {
+    stream.next(m.header.seq);
+    stream.next(m.header.stamp);
+    skipString(stream);
+    stream.next(m.level);
+    stream.next(m.name);
+    stream.next(m.msg);
+    stream.next(m.file);
+    stream.next(m.function);
+    stream.next(m.line);
+
+    uint32_t topics = 0;
+    stream.next(topics);
+    for (uint32_t i = 0; i < topics; i++) {
+      skipString(stream);
+    }
+  }
+
+  inline static uint32_t serializedLength(const swri_console::RosoutMessage& m)
+  {
+    return (4 + 8 + 4 + 1 +
+            4 + m.name.size() +
+            4 + m.msg.size() +
+            4 + m.file.size() +
+            4 + m.function.size() +
+            4 + 4);
+  }
+
+ private:
+  template<typename Stream>
+  inline static void skipString(Stream& stream)
+  {
+    uint32_t length = 0;
+    stream.next(length);
+    stream.advance(length);
+  }
+};
+}  // namespace serialization
+}  // namespace ros
+
+#endif  // SWRI_CONSOLE_ROSOUT_MESSAGE_H_
@@ -0,0 +1,158 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_SESSION_FILE_H_
+#define SWRI_CONSOLE_SESSION_FILE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <QFile>
+#include <QSaveFile>
+#include <QSharedPointer>
+#include <QString>
+
+#include <swri_console/log_body_source.h>
+#include <swri_console/log_database.h>
+#include <swri_console/string_table.h>
+
+namespace swri_console
+{
+// Session files save log entries with all of their metadata in a
+// compact form that can be memory-mapped when it is reopened.  The
+// file consists of a header, an arena holding the UTF-8 text of every
+// message, the string tables (nodes, files, functions and message
+// templates), and one column per field:
+//
+//   stamp, last stamp,
+//   body offset              (uint64_t)
+//   seq, line, node, file,
+//   function, template,
+//   line count, repeat count,
+//   body length              (uint32_t)
+//   level                    (uint8_t)
+//
+// Message text is written to the arena as entries are added, so only
+// the columns are held in memory while writing.
+
+// Writes a session file.
+class SessionWriter
+{
+ public:
+  explicit SessionWriter(const QString &filename);
+
+  bool open();
+  void add(const LogEntry &entry,
+           const std::string &node,
+           const std::string &file,
+           const std::string &function,
+           const QByteArray &template_key,
+           uint32_t repeat_count,
+           const ros::Time &last_stamp,
+           const QStringList &text);
+  // Writes the columns and string tables and replaces the file.
+  // Returns false if anything failed to write.
+  bool finish();
+
+ private:
+  QSaveFile file_;
+  bool ok_;
+  uint64_t arena_size_;
+
+  StringTable nodes_;
+  StringTable files_;
+  StringTable functions_;
+  StringTable templates_;
+
+  std::vector<uint64_t> stamps_;
+  std::vector<uint64_t> last_stamps_;
+  std::vector<uint64_t> body_offsets_;
+  std::vector<uint32_t> seqs_;
+  std::vector<uint32_t> lines_;
+  std::vector<uint32_t> node_ids_;
+  std::vector<uint32_t> file_ids_;
+  std::vector<uint32_t> function_ids_;
+  std::vector<uint32_t> template_ids_;
+  std::vector<uint32_t> line_counts_;
+  std::vector<uint32_t> repeat_counts_;
+  std::vector<uint32_t> body_lengths_;
+  std::vector<uint8_t> levels_;
+};
+
+// A memory-mapped session file.  It is also the body source for the
+// entries loaded from it; their locator is their row.
+class SessionFile : public LogBodySource
+{
+ public:
+  // Returns the session in filename, or a null pointer if it can't be
+  // read.
+  static QSharedPointer<SessionFile> open(const QString &filename);
+
+  size_t size() const { return rows_; }
+  void message(size_t row, IndexedMessage *msg) const;
+
+  virtual QStringList text(uint64_t locator);
+
+ private:
+  explicit SessionFile(const QString &filename);
+  bool load();
+
+  QFile file_;
+  const uchar *data_;
+  size_t size_;
+  size_t rows_;
+
+  std::vector<std::string> nodes_;
+  std::vector<std::string> files_;
+  std::vector<std::string> functions_;
+  std::vector<QByteArray> templates_;
+
+  // Offset and size of the text arena.
+  uint64_t arena_offset_;
+  uint64_t arena_size_;
+
+  // Columns, pointing into the mapped file.
+  const uint64_t *stamps_;
+  const uint64_t *last_stamps_;
+  const uint64_t *body_offsets_;
+  const uint32_t *seqs_;
+  const uint32_t *lines_;
+  const uint32_t *node_ids_;
+  const uint32_t *file_ids_;
+  const uint32_t *function_ids_;
+  const uint32_t *template_ids_;
+  const uint32_t *line_counts_;
+  const uint32_t *repeat_counts_;
+  const uint32_t *body_lengths_;
+  const uint8_t *levels_;
+};
+}  // namespace swri_console
+#endif  // SWRI_CONSOLE_SESSION_FILE_H_
@@ -0,0 +1,139 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_SESSION_JOURNAL_H
+#define SWRI_CONSOLE_SESSION_JOURNAL_H
+
+#include <string>
+#include <vector>
+
+#include <QFile>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <rosgraph_msgs/Log.h>
+#include <swri_console/log_database.h>
+#include <swri_console/rosout_message.h>
+
+namespace swri_console
+{
+  /**
+   * Appends live log messages to a journal file so that a session can be
+   * recovered if the console crashes.
+   *
+   * Messages are handed to the journal with append(), which only queues
+   * them.  A background thread collects everything queued since its last
+   * write into a single frame and writes and syncs it (group commit), so
+   * the ingest path never waits on the disk.  Each frame holds a header
+   * with its length and checksum, followed by the serialized messages; a
+   * frame that was only partly written when the console died is ignored
+   * on recovery.
+   */
+  class SessionJournal : public QThread
+  {
+    Q_OBJECT
+  public:
+    SessionJournal();
+    ~SessionJournal();
+
+    /**
+     * Starts journaling to filename, appending to it if it exists.
+     * Returns false if the file can't be opened.
+     */
+    bool open(const QString& filename);
+
+    /**
+     * Writes any queued messages and stops the background thread.
+     */
+    void close();
+
+    bool isOpen() const { return isRunning(); }
+
+    /**
+     * Reads every complete frame from a journal file.  Returns false if
+     * the file can't be read.
+     */
+    static bool recover(const QString& filename, MessageList* msgs);
+
+    /**
+     * The journal for the running console, and the journal left behind
+     * by the previous run.
+     */
+    static QString journalPath();
+    static QString previousJournalPath();
+
+    /**
+     * Names the database source that source_id refers to in
+     * append(int, const RosoutMessageList&).
+     */
+    void setSourceName(int source_id, const std::string& name);
+
+  public Q_SLOTS:
+    /**
+     * Queues messages to be journaled.  These are safe to call from any
+     * thread.
+     */
+    void append(const RosoutMessageList& msgs);
+    void append(const MessageList& msgs);
+
+    /**
+     * Queues messages from an additional ROS master.  The journal has
+     * no notion of sources, so the messages are journaled with their
+     * node names in the source's namespace, the way the database shows
+     * them, and are recovered into the local source.
+     */
+    void append(int source_id, const RosoutMessageList& msgs);
+
+    /**
+     * Discards everything journaled so far, e.g. after the database is
+     * cleared.
+     */
+    void reset();
+
+  protected:
+    void run();
+
+  private:
+    bool writeFrame(const RosoutMessageList& msgs);
+
+    QFile file_;
+
+    QMutex mutex_;
+    QWaitCondition wake_;
+    RosoutMessageList pending_;
+    std::vector<std::string> source_names_;
+    bool stopping_;
+    bool reset_requested_;
+  };
+}
+
+#endif //SWRI_CONSOLE_SESSION_JOURNAL_H
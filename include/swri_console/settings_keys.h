@@ -63,6 +63,13 @@ namespace swri_console
     static const QString FATAL_COLOR;
     static const QString COLORIZE_LOGS;
     static const QString ALTERNATE_LOG_ROW_COLORS;
+    static const QString COLLAPSE_REPEATS;
+    static const QString BODY_CACHE_SIZE;
+    static const QString JOURNAL_SESSION;
+    static const QString SUBSCRIBE_ROSOUT;
+    static const QString RATE_LIMIT;
+    static const QString MEMORY_BUDGET;
+    static const QString SPILL_BUDGET;
   };
 }
 
@@ -0,0 +1,69 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_STRING_TABLE_H_
+#define SWRI_CONSOLE_STRING_TABLE_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <boost/unordered_map.hpp>
+
+namespace swri_console
+{
+// Assigns small integer ids to strings that repeat across many log
+// entries, such as file and function names, so that each distinct
+// string is only stored once.
+class StringTable
+{
+ public:
+  uint32_t intern(const std::string &str)
+  {
+    boost::unordered_map<std::string, uint32_t>::const_iterator it = ids_.find(str);
+    if (it != ids_.end()) {
+      return it->second;
+    }
+
+    uint32_t id = strings_.size();
+    ids_[str] = id;
+    strings_.push_back(str);
+    return id;
+  }
+
+  size_t size() const { return strings_.size(); }
+  const std::string& operator[](uint32_t id) const { return strings_[id]; }
+
+ private:
+  boost::unordered_map<std::string, uint32_t> ids_;
+  std::vector<std::string> strings_;
+};
+}  // namespace swri_console
+#endif  // SWRI_CONSOLE_STRING_TABLE_H_
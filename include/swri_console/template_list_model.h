@@ -28,42 +28,40 @@
 //
 // *****************************************************************************
 
-#ifndef SWRI_CONSOLE_NODE_LIST_MODEL_H_
-#define SWRI_CONSOLE_NODE_LIST_MODEL_H_
+#ifndef SWRI_CONSOLE_TEMPLATE_LIST_MODEL_H_
+#define SWRI_CONSOLE_TEMPLATE_LIST_MODEL_H_
 
-#include <string>
-#include <vector>
-#include <map>
+#include <stdint.h>
 #include <QAbstractListModel>
 
 namespace swri_console
 {
 class LogDatabase;
-class NodeListModel : public QAbstractListModel
+
+// Presents one row per message template in the log database, along
+// with the number of messages that matched it.  Rows are listed in
+// the order the templates were first seen, and the row number is the
+// template's id.
+class TemplateListModel : public QAbstractListModel
 {
   Q_OBJECT
-  
+
  public:
-  NodeListModel(LogDatabase* db);
-  ~NodeListModel();
+  TemplateListModel(LogDatabase *db);
+  ~TemplateListModel();
+
+  uint32_t templateId(const QModelIndex &index) const;
 
-  std::string nodeName(const QModelIndex &index) const;
-  
   virtual int rowCount(const QModelIndex &parent) const;
   virtual QVariant data(const QModelIndex &index, int role) const;
 
- public Q_SLOTS:
-  void clear();
-                                                                 
  private Q_SLOTS:
   void handleDatabaseCleared();
   void handleMessagesAdded();
-  
+
  private:
   LogDatabase *db_;
-  
-  std::map<std::string, size_t> data_;
-  std::vector<std::string> ordering_;
+  size_t row_count_;
 };
 }  // namespace swri_console
-#endif  // SWRI_CONSOLE_NODE_LIST_MODEL_H_
+#endif  // SWRI_CONSOLE_TEMPLATE_LIST_MODEL_H_
@@ -0,0 +1,185 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_TEXT_LOG_READER_H
+#define SWRI_CONSOLE_TEXT_LOG_READER_H
+
+#include <string>
+#include <vector>
+
+#include <QObject>
+#include <QSemaphore>
+#include <QStringList>
+#include <QThread>
+
+#include <rosgraph_msgs/Log.h>
+#include <swri_console/log_database.h>
+
+class QProgressDialog;
+class QThreadPool;
+
+namespace swri_console
+{
+  struct TextLogStream;
+
+  /**
+   * Parses a line of a text log file (without its line break).  Returns
+   * false if the line doesn't start a message, i.e. it is a continuation
+   * of the message before it.  default_node is used for formats that
+   * don't include the node name.
+   */
+  bool parseTextLogRecord(const char* begin, const char* end,
+                          const std::string& default_node,
+                          rosgraph_msgs::Log* log);
+
+  /**
+   * Derives a node name from the name of a node's log file, for formats
+   * that don't include it.
+   */
+  std::string textLogNodeName(const QString& filename);
+
+  /**
+   * Reads log messages from the text files that ROS writes to ~/.ros/log
+   * on a background thread.  Three formats are recognized:
+   *  - rosout.log, which has every field of the original message:
+   *    "<stamp> <LEVEL> <node> [<file>:<line>(<function>)] [topics: ...] <msg>"
+   *  - console output captured from a node:
+   *    "[ INFO] [<stamp>]: <msg>"
+   *  - rospy node logs:
+   *    "[<logger>][INFO] 2019-01-08 12:00:00,123: <msg>"
+   * Lines that don't start a message are continuation lines of the
+   * message before them.  For formats without a node name, it is taken
+   * from the file name.
+   *
+   * Files are memory mapped and split into chunks at the start of a
+   * message, and the chunks are parsed in parallel.  The messages of
+   * all the files are merged by stamp, so that the nodes of a run are
+   * interleaved, and are numbered in the order they are delivered.
+   * The thread waits when too many batches haven't been acknowledged
+   * with batchDelivered().
+   */
+  class TextLogReaderThread : public QThread
+  {
+    Q_OBJECT
+  public:
+    explicit TextLogReaderThread(const QStringList& filenames);
+
+    /**
+     * Asks the thread to stop reading.  Messages that were already
+     * delivered are kept.
+     */
+    void cancel();
+
+    /**
+     * Called once a batch from messagesRead has been consumed, so that
+     * the thread can deliver another.
+     */
+    void batchDelivered();
+
+    bool wasCancelled() const { return cancelled_; }
+    const QString& errorString() const { return error_; }
+
+  Q_SIGNALS:
+    /**
+     * Emitted with batches of messages as they are read.
+     */
+    void messagesRead(const MessageList& msgs);
+
+    /**
+     * Emitted as the thread advances through the files, with progress
+     * between 0 and 1000.
+     */
+    void progress(int permille);
+
+  protected:
+    void run();
+
+  private:
+    bool openFile(const QString& filename, TextLogStream* stream);
+    void readMerged(std::vector<TextLogStream>* streams);
+    void scheduleChunks(QThreadPool* pool, TextLogStream* stream, size_t depth);
+    bool nextMessage(QThreadPool* pool, TextLogStream* stream, size_t depth);
+    const rosgraph_msgs::LogPtr& currentMessage(const TextLogStream& stream);
+    void deliver(MessageList* msgs);
+    void reportProgress(qint64 bytes);
+
+    QStringList filenames_;
+    QString error_;
+    volatile bool cancelled_;
+    QSemaphore batch_slots_;
+
+    qint64 total_bytes_;
+    qint64 done_bytes_;
+    int last_progress_;
+  };
+
+  class TextLogReader : public QObject
+  {
+    Q_OBJECT
+  public:
+    TextLogReader();
+    ~TextLogReader();
+
+    /**
+     * Starts reading text log files in the background.
+     * @param[in] filenames The names of the log files to load.
+     */
+    void readTextLogs(const QStringList& filenames);
+
+  public Q_SLOTS:
+    /**
+     * Displays a file dialog that prompts the user to pick one or more
+     * text log files, and reads them.
+     */
+    void promptForTextLogs();
+
+  Q_SIGNALS:
+    /**
+     * Emitted with batches of log messages as they are read.
+     */
+    void logsReceived(const MessageList& msgs);
+
+    /**
+     * Emitted after we're completely done reading the files.
+     */
+    void finishedReading();
+
+  private Q_SLOTS:
+    void deliverBatch(const MessageList& msgs);
+    void cancelReading();
+    void handleThreadFinished();
+
+  private:
+    TextLogReaderThread* thread_;
+    QProgressDialog* progress_dialog_;
+  };
+}
+
+#endif //SWRI_CONSOLE_TEXT_LOG_READER_H
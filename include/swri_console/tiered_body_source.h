@@ -0,0 +1,115 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#ifndef SWRI_CONSOLE_TIERED_BODY_SOURCE_H_
+#define SWRI_CONSOLE_TIERED_BODY_SOURCE_H_
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+#include <QByteArray>
+#include <QMutex>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include <swri_console/log_body_source.h>
+
+namespace swri_console
+{
+// Holds the text of log entries that were moved out of the store to
+// stay within the memory budget.  Text is moved a store chunk at a
+// time, and each chunk degrades through three tiers: its text is
+// first compressed in memory, then spilled to a temporary file, and
+// finally dropped.  The locator of an entry is its index in the store.
+class TieredBodySource : public LogBodySource
+{
+ public:
+  enum Tier
+  {
+    COMPRESSED,
+    SPILLED,
+    DROPPED
+  };
+
+  TieredBodySource();
+
+  // Compresses the text of a chunk.  texts[i] is the text of the i-th
+  // entry in the chunk; entries whose text isn't held by this source
+  // should have an empty list.
+  void compress(size_t chunk, const std::vector<QStringList> &texts);
+  // Writes a compressed chunk to the spill directory and frees its
+  // memory.  Returns false if it couldn't be written, in which case
+  // the chunk stays in memory.
+  bool spill(size_t chunk);
+  // Forgets a chunk's text.  The entries are shown with a note that
+  // their text was dropped.
+  void drop(size_t chunk);
+
+  // The size of the compressed chunks in memory and on disk, and the
+  // number of entries whose text was dropped.
+  size_t compressedBytes() const { return compressed_bytes_; }
+  size_t spilledBytes() const { return spilled_bytes_; }
+  size_t droppedEntries() const { return dropped_entries_; }
+
+  virtual QStringList text(uint64_t locator);
+  virtual void textRange(uint64_t first, size_t count, std::vector<QStringList> *texts);
+
+ private:
+  struct Chunk
+  {
+    Tier tier;
+    // The compressed text, while the chunk is in memory.
+    QByteArray data;
+    int size;
+    // The number of entries whose text is held.
+    size_t entries;
+  };
+
+  QString spillPath(size_t chunk) const;
+  // Decompresses a chunk into the cache.
+  bool loadChunk(size_t chunk);
+
+  // Guards everything below.  The sizes are only written by the
+  // database's thread, so they are read there without locking.
+  QMutex mutex_;
+  std::map<size_t, Chunk> chunks_;
+  QTemporaryDir spill_dir_;
+  size_t compressed_bytes_;
+  size_t spilled_bytes_;
+  size_t dropped_entries_;
+
+  // The chunk that was read last, decompressed, since reads come in
+  // runs of consecutive entries.
+  size_t cached_chunk_;
+  std::vector<QStringList> cached_texts_;
+};
+}  // namespace swri_console
+#endif  // SWRI_CONSOLE_TIERED_BODY_SOURCE_H_
@@ -0,0 +1,446 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+#include <QDateTime>
+#include <QDir>
+#include <QHash>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#include <swri_console/bag_index.h>
+#include <swri_console/column_file.h>
+
+#include <rosbag/view.h>
+
+namespace swri_console
+{
+namespace
+{
+const char INDEX_MAGIC[8] = { 'S', 'W', 'C', 'I', 'D', 'X', '\0', '\0' };
+// Version 2 changed how message templates are derived.
+const uint32_t INDEX_VERSION = 2;
+
+struct IndexHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  // The size and modification time of the bag when the index was
+  // written.  If either has changed, the index is stale.
+  uint64_t bag_size;
+  int64_t bag_mtime;
+  uint64_t rows;
+  // Offset of the first column; the string tables are between the
+  // header and the columns.
+  uint64_t columns_offset;
+};
+
+// Bytes per row, summed over all columns.
+const size_t ROW_SIZE = 2 * sizeof(uint64_t) + 7 * sizeof(uint32_t) + sizeof(uint8_t);
+
+// Bytes per row of each column, in the order they are written.
+const size_t COLUMN_SIZES[] = {
+  sizeof(uint64_t), sizeof(uint64_t),
+  sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t),
+  sizeof(uint32_t), sizeof(uint32_t), sizeof(uint32_t),
+  sizeof(uint8_t) };
+const size_t COLUMN_COUNT = sizeof(COLUMN_SIZES) / sizeof(COLUMN_SIZES[0]);
+
+// Rows an index writer keeps in memory before spilling them.
+const size_t SPILL_BLOCK_ROWS = 1 << 16;
+
+const std::string LOG_DATATYPE = "rosgraph_msgs/Log";
+}  // namespace
+
+QString bagIndexPath(const QString &bag_filename)
+{
+  QFileInfo bag_info(bag_filename);
+  if (QFileInfo(bag_info.absolutePath()).isWritable()) {
+    return bag_filename + ".logidx";
+  }
+
+  return QDir(QDir::tempPath()).filePath(
+    QString("swri_console_%1_%2.logidx")
+    .arg(qHash(bag_info.absoluteFilePath()), 8, 16, QChar('0'))
+    .arg(bag_info.fileName()));
+}
+
+BagIndexWriter::BagIndexWriter()
+  :
+  spilled_rows_(0),
+  spill_failed_(false)
+{
+}
+
+void BagIndexWriter::add(const rosgraph_msgs::Log &msg, const ros::Time &receipt_time)
+{
+  const QByteArray fingerprint = templateFingerprint(msg.msg);
+
+  stamps_.push_back(msg.header.stamp.toNSec());
+  receipt_times_.push_back(receipt_time.toNSec());
+  seqs_.push_back(msg.header.seq);
+  lines_.push_back(msg.line);
+  node_ids_.push_back(nodes_.intern(msg.name));
+  file_ids_.push_back(files_.intern(msg.file));
+  function_ids_.push_back(functions_.intern(msg.function));
+  template_ids_.push_back(templates_.intern(std::string(fingerprint.constData(), fingerprint.size())));
+  line_counts_.push_back(std::count(msg.msg.begin(), msg.msg.end(), '\n') + 1);
+  levels_.push_back(msg.level);
+
+  if (stamps_.size() >= SPILL_BLOCK_ROWS) {
+    spillBlock();
+  }
+}
+
+void BagIndexWriter::spillBlock()
+{
+  // If the spill file can't be written, the rows just stay in memory.
+  // A partially written block is never read back because it isn't
+  // added to spilled_blocks_.
+  if (spill_failed_) {
+    return;
+  }
+  if (!spill_.isOpen() && !spill_.open()) {
+    spill_failed_ = true;
+    return;
+  }
+  for (size_t column = 0; column < COLUMN_COUNT; column++) {
+    if (!writeBlockColumn(&spill_, column)) {
+      spill_failed_ = true;
+      return;
+    }
+  }
+
+  spilled_blocks_.push_back(stamps_.size());
+  spilled_rows_ += stamps_.size();
+
+  // clear() keeps the capacity, so the next block reuses it.
+  stamps_.clear();
+  receipt_times_.clear();
+  seqs_.clear();
+  lines_.clear();
+  node_ids_.clear();
+  file_ids_.clear();
+  function_ids_.clear();
+  template_ids_.clear();
+  line_counts_.clear();
+  levels_.clear();
+}
+
+bool BagIndexWriter::writeBlockColumn(QIODevice *device, size_t column) const
+{
+  switch (column) {
+    case 0: return writeColumn(device, stamps_);
+    case 1: return writeColumn(device, receipt_times_);
+    case 2: return writeColumn(device, seqs_);
+    case 3: return writeColumn(device, lines_);
+    case 4: return writeColumn(device, node_ids_);
+    case 5: return writeColumn(device, file_ids_);
+    case 6: return writeColumn(device, function_ids_);
+    case 7: return writeColumn(device, template_ids_);
+    case 8: return writeColumn(device, line_counts_);
+    case 9: return writeColumn(device, levels_);
+  }
+  return false;
+}
+
+bool BagIndexWriter::copySpilledColumn(QIODevice *device, size_t column)
+{
+  size_t column_offset = 0;
+  for (size_t i = 0; i < column; i++) {
+    column_offset += COLUMN_SIZES[i];
+  }
+
+  uint64_t block_offset = 0;
+  for (size_t i = 0; i < spilled_blocks_.size(); i++) {
+    const uint64_t rows = spilled_blocks_[i];
+    const qint64 bytes = rows * COLUMN_SIZES[column];
+    if (!spill_.seek(block_offset + rows * column_offset)) {
+      return false;
+    }
+    const QByteArray data = spill_.read(bytes);
+    if (data.size() != bytes || device->write(data) != bytes) {
+      return false;
+    }
+    block_offset += rows * ROW_SIZE;
+  }
+  return true;
+}
+
+bool BagIndexWriter::write(const QString &bag_filename)
+{
+  QFileInfo bag_info(bag_filename);
+
+  // QSaveFile only replaces the old index once the new one is
+  // completely written.
+  QSaveFile file(bagIndexPath(bag_filename));
+  if (!file.open(QIODevice::WriteOnly)) {
+    return false;
+  }
+
+  QByteArray strings;
+  appendStringTable(&strings, nodes_);
+  appendStringTable(&strings, files_);
+  appendStringTable(&strings, functions_);
+  appendStringTable(&strings, templates_);
+  // Pad so that the columns are aligned.
+  padToAlignment(&strings, sizeof(IndexHeader));
+
+  IndexHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+  header.version = INDEX_VERSION;
+  header.bag_size = bag_info.size();
+  header.bag_mtime = bag_info.lastModified().toMSecsSinceEpoch();
+  header.rows = spilled_rows_ + stamps_.size();
+  header.columns_offset = sizeof(IndexHeader) + strings.size();
+
+  bool ok = (file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header) &&
+             file.write(strings) == strings.size());
+  // Each column is the spilled rows followed by the ones still in
+  // memory.
+  for (size_t column = 0; ok && column < COLUMN_COUNT; column++) {
+    ok = copySpilledColumn(&file, column) && writeBlockColumn(&file, column);
+  }
+  if (!ok) {
+    file.cancelWriting();
+    return false;
+  }
+  return file.commit();
+}
+
+BagIndex::BagIndex(const QString &path)
+  :
+  file_(path),
+  rows_(0)
+{
+}
+
+QSharedPointer<BagIndex> BagIndex::open(const QString &bag_filename)
+{
+  QSharedPointer<BagIndex> index(new BagIndex(bagIndexPath(bag_filename)));
+  if (!index->load(bag_filename)) {
+    return QSharedPointer<BagIndex>();
+  }
+  return index;
+}
+
+bool BagIndex::load(const QString &bag_filename)
+{
+  if (!file_.exists() || !file_.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+
+  const size_t size = file_.size();
+  if (size < sizeof(IndexHeader)) {
+    return false;
+  }
+  const uchar *data = file_.map(0, size);
+  if (!data) {
+    return false;
+  }
+
+  IndexHeader header;
+  std::memcpy(&header, data, sizeof(header));
+
+  QFileInfo bag_info(bag_filename);
+  if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != INDEX_VERSION ||
+      header.bag_size != static_cast<uint64_t>(bag_info.size()) ||
+      header.bag_mtime != bag_info.lastModified().toMSecsSinceEpoch()) {
+    return false;
+  }
+
+  std::vector<std::string> templates;
+  size_t offset = sizeof(IndexHeader);
+  if (!readStringTable(data, size, &offset, &nodes_) ||
+      !readStringTable(data, size, &offset, &files_) ||
+      !readStringTable(data, size, &offset, &functions_) ||
+      !readStringTable(data, size, &offset, &templates)) {
+    return false;
+  }
+  for (size_t i = 0; i < templates.size(); i++) {
+    templates_.push_back(QByteArray(templates[i].data(), templates[i].size()));
+  }
+
+  // The row count is checked by division so that a corrupt count
+  // can't overflow past the size check.
+  if (header.columns_offset < offset ||
+      header.columns_offset % sizeof(uint64_t) != 0 ||
+      header.columns_offset > size ||
+      header.rows > (size - header.columns_offset) / ROW_SIZE) {
+    return false;
+  }
+  rows_ = header.rows;
+
+  offset = header.columns_offset;
+  stamps_ = mapColumn<uint64_t>(data, &offset, rows_);
+  receipt_times_ = mapColumn<uint64_t>(data, &offset, rows_);
+  seqs_ = mapColumn<uint32_t>(data, &offset, rows_);
+  lines_ = mapColumn<uint32_t>(data, &offset, rows_);
+  node_ids_ = mapColumn<uint32_t>(data, &offset, rows_);
+  file_ids_ = mapColumn<uint32_t>(data, &offset, rows_);
+  function_ids_ = mapColumn<uint32_t>(data, &offset, rows_);
+  template_ids_ = mapColumn<uint32_t>(data, &offset, rows_);
+  line_counts_ = mapColumn<uint32_t>(data, &offset, rows_);
+  levels_ = mapColumn<uint8_t>(data, &offset, rows_);
+
+  // Check the ids once so that a damaged index can't send us out of
+  // bounds later.
+  return (columnIdsValid(node_ids_, rows_, nodes_) &&
+          columnIdsValid(file_ids_, rows_, files_) &&
+          columnIdsValid(function_ids_, rows_, functions_) &&
+          columnIdsValid(template_ids_, rows_, templates_));
+}
+
+void BagIndex::message(size_t row, IndexedMessage *msg) const
+{
+  msg->stamp = stamp(row);
+  msg->level = levels_[row];
+  msg->seq = seqs_[row];
+  msg->node = nodes_[node_ids_[row]];
+  msg->file = files_[file_ids_[row]];
+  msg->function = functions_[function_ids_[row]];
+  msg->line = lines_[row];
+  msg->line_count = line_counts_[row];
+  msg->template_key = templates_[template_ids_[row]];
+  msg->repeat_count = 1;
+  msg->last_stamp = msg->stamp;
+  msg->body_locator = row;
+}
+
+ros::Time BagIndex::receiptTime(size_t row) const
+{
+  ros::Time time;
+  time.fromNSec(receipt_times_[row]);
+  return time;
+}
+
+ros::Time BagIndex::stamp(size_t row) const
+{
+  ros::Time time;
+  time.fromNSec(stamps_[row]);
+  return time;
+}
+
+BagBodySource::BagBodySource(const QString &bag_filename,
+                             const QSharedPointer<BagIndex> &index)
+  :
+  bag_filename_(bag_filename),
+  index_(index),
+  bag_open_(false)
+{
+}
+
+bool BagBodySource::openBag()
+{
+  if (!bag_open_) {
+    bag_.open(bag_filename_.toStdString(), rosbag::bagmode::Read);
+    bag_open_ = true;
+  }
+  return bag_open_;
+}
+
+bool BagBodySource::matches(const rosgraph_msgs::Log &log, uint64_t row) const
+{
+  return (log.header.seq == index_->seq(row) &&
+          log.header.stamp == index_->stamp(row) &&
+          log.name == index_->node(row));
+}
+
+QStringList BagBodySource::text(uint64_t locator)
+{
+  std::vector<QStringList> texts;
+  textRange(locator, 1, &texts);
+  if (texts.empty()) {
+    return QStringList();
+  }
+  return texts[0];
+}
+
+void BagBodySource::textRange(uint64_t first, size_t count, std::vector<QStringList> *texts)
+{
+  texts->clear();
+  if (first >= index_->size()) {
+    return;
+  }
+  count = std::min<uint64_t>(count, index_->size() - first);
+  texts->resize(count);
+
+  QMutexLocker lock(&mutex_);
+  try
+  {
+    openBag();
+
+    // Rows are in receipt time order, so the bag's own index takes us
+    // straight to the chunks holding them and they can be read in a
+    // single pass.  The view also contains messages that were dropped
+    // as duplicates, so each message is matched to its row by node,
+    // seq and stamp.
+    rosbag::View view(bag_, rosbag::TypeQuery(LOG_DATATYPE),
+                      index_->receiptTime(first),
+                      index_->receiptTime(first + count - 1));
+
+    size_t next = 0;
+    for (rosbag::View::const_iterator iter = view.begin(); iter != view.end(); ++iter)
+    {
+      rosgraph_msgs::LogConstPtr log = iter->instantiate<rosgraph_msgs::Log>();
+      if (log == NULL) {
+        continue;
+      }
+
+      // Messages almost always come out in row order; if not, search
+      // the rest of the range.
+      size_t row = next;
+      if (row >= count || !matches(*log, first + row)) {
+        for (row = 0; row < count; row++) {
+          if ((*texts)[row].isEmpty() && matches(*log, first + row)) {
+            break;
+          }
+        }
+      }
+      if (row < count) {
+        (*texts)[row] = QString(log->msg.c_str()).split('\n');
+        next = row + 1;
+      }
+    }
+  }
+  catch (const std::exception& e)
+  {
+    qWarning("Failed to read messages from %s: %s",
+             bag_filename_.toStdString().c_str(), e.what());
+  }
+}
+}  // namespace swri_console
@@ -28,50 +28,932 @@
 //
 // *****************************************************************************
 
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <queue>
+
+#include <boost/functional/hash.hpp>
+#include <boost/unordered_map.hpp>
+
 #include <QFileDialog>
 #include <QDir>
+#include <QMessageBox>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QProgressDialog>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QWaitCondition>
 
 #include "include/swri_console/bag_reader.h"
+#include <swri_console/bag_index.h>
 
 #include <rosbag/bag.h>
 #include <rosbag/view.h>
+#include <ros/serialization.h>
 
 using namespace swri_console;
 
-void BagReader::readBagFile(const QString& filename)
+// Messages are delivered to the database in batches of this size, so
+// that the GUI thread isn't flooded with events for every message.
+static const size_t BATCH_SIZE = 10000;
+
+// Bags are only split into partitions if each partition will have at
+// least this many messages; below that, opening the bag again for
+// every partition costs more than decoding it on one core.
+static const uint32_t MIN_PARTITION_SIZE = 50000;
+
+// Fingerprints are remembered for at least this many seconds of
+// receipt time.  Copies of a message recorded on different topics
+// arrive well within this.
+static const double FINGERPRINT_WINDOW = 10.0;
+
+// The smallest table of message fingerprints; tables are always a
+// power of two in size.
+static const size_t MIN_FINGERPRINT_SLOTS = 1 << 16;
+
+// Returns where to start probing for a fingerprint.  Mixing in the
+// high bits keeps runs short however the hash distributes its low bits.
+static size_t fingerprintSlot(quint64 fingerprint, size_t mask)
+{
+  return (fingerprint ^ (fingerprint >> 32) ^ (fingerprint >> 17)) & mask;
+}
+
+// Each partition of a bag may have this many decoded batches waiting
+// to be delivered before its task blocks.  A partition usually holds
+// about MIN_PARTITION_SIZE / BATCH_SIZE batches, so this only blocks
+// partitions that are much denser than average.
+static const size_t PARTITION_QUEUE_DEPTH = 8;
+
+// When merging several bags, each bag may have this many decoded
+// batches waiting before its task blocks.  Batches are scaled down by
+// the number of bags so the total stays near a couple of full batches.
+static const size_t MERGE_QUEUE_DEPTH = 2;
+static const size_t MIN_MERGE_BATCH_SIZE = 256;
+
+// Log messages are read from every topic with this type, since bags may
+// have recorded /rosout, /rosout_agg or namespaced rosout topics.
+static const std::string LOG_DATATYPE = "rosgraph_msgs/Log";
+
+bool BagImportFilter::acceptsAll() const
+{
+  const uint8_t all_levels = rosgraph_msgs::Log::DEBUG | rosgraph_msgs::Log::INFO |
+    rosgraph_msgs::Log::WARN | rosgraph_msgs::Log::ERROR | rosgraph_msgs::Log::FATAL;
+  return (severity_mask & all_levels) == all_levels && names.empty() && prefixes.empty();
+}
+
+bool BagImportFilter::acceptNode(const std::string& name) const
+{
+  if (names.empty() && prefixes.empty()) {
+    return true;
+  }
+
+  bool accepted = names.count(name) != 0;
+  for (std::set<std::string>::const_iterator it = prefixes.begin();
+       !accepted && it != prefixes.end();
+       ++it)
+  {
+    accepted = name.compare(0, it->size(), *it) == 0;
+  }
+  return accepted;
+}
+
+namespace
 {
-  rosbag::Bag bag;
-  bag.open(filename.toStdString(), rosbag::bagmode::Read);
+  /**
+   * Reads the level and node name from a serialized rosgraph_msgs/Log
+   * without decoding the rest of the message.  Returns false if the
+   * buffer is too short to be a log message.
+   */
+  bool peekLevelAndName(const std::vector<uint8_t>& buffer,
+                        uint8_t* level,
+                        std::string* name)
+  {
+    // The header is a uint32 seq, a time (two uint32s) and a string
+    // frame_id; strings are a uint32 length followed by the bytes.
+    size_t offset = 12;
+    uint32_t length = 0;
+
+    if (offset + 4 > buffer.size()) {
+      return false;
+    }
+    std::memcpy(&length, &buffer[offset], 4);
+    offset += 4 + length;
+
+    if (offset + 1 + 4 > buffer.size()) {
+      return false;
+    }
+    *level = buffer[offset];
+    offset += 1;
+
+    std::memcpy(&length, &buffer[offset], 4);
+    offset += 4;
+    if (offset + length > buffer.size()) {
+      return false;
+    }
+    name->assign(reinterpret_cast<const char*>(&buffer[0]) + offset, length);
+    return true;
+  }
+
+  struct LogBatch
+  {
+    MessageList msgs;
+    // Receipt time of each message in the batch.
+    std::vector<ros::Time> times;
+  };
+
+  /**
+   * Hands decoded batches from a decoding task to the reader thread.
+   * A queue with a capacity blocks the task while it is full.
+   */
+  class BatchQueue
+  {
+  public:
+    explicit BatchQueue(size_t capacity = 0) :
+      capacity_(capacity),
+      closed_(false),
+      aborted_(false)
+    {
+    }
+
+    /**
+     * Adds a batch, waiting for room if the queue is full.  Returns
+     * false if the reader has given up on the queue.
+     */
+    bool push(const LogBatch& batch)
+    {
+      QMutexLocker lock(&mutex_);
+      while (capacity_ > 0 && batches_.size() >= capacity_ && !aborted_) {
+        not_full_.wait(&mutex_);
+      }
+      if (aborted_) {
+        return false;
+      }
+      batches_.push_back(batch);
+      not_empty_.wakeOne();
+      return true;
+    }
+
+    /**
+     * Waits for the next batch.  Returns false once the queue is
+     * closed and there are no more batches.
+     */
+    bool pop(LogBatch& batch)
+    {
+      QMutexLocker lock(&mutex_);
+      while (batches_.empty() && !closed_) {
+        not_empty_.wait(&mutex_);
+      }
+      if (batches_.empty()) {
+        return false;
+      }
+      batch = batches_.front();
+      batches_.pop_front();
+      not_full_.wakeOne();
+      return true;
+    }
+
+    void close(const QString& error)
+    {
+      QMutexLocker lock(&mutex_);
+      closed_ = true;
+      error_ = error;
+      not_empty_.wakeAll();
+    }
+
+    /**
+     * Releases a task that is blocked on a full queue.
+     */
+    void abort()
+    {
+      QMutexLocker lock(&mutex_);
+      aborted_ = true;
+      batches_.clear();
+      not_full_.wakeAll();
+    }
+
+    QString error()
+    {
+      QMutexLocker lock(&mutex_);
+      return error_;
+    }
+
+  private:
+    QMutex mutex_;
+    QWaitCondition not_empty_;
+    QWaitCondition not_full_;
+    std::deque<LogBatch> batches_;
+    size_t capacity_;
+    bool closed_;
+    bool aborted_;
+    QString error_;
+  };
+
+  /**
+   * Decodes the log messages in one time range of a bag.  Each task
+   * opens its own rosbag::Bag, since a Bag can't be shared between
+   * threads.
+   */
+  class DecodeTask : public QRunnable
+  {
+  public:
+    DecodeTask(const QString& filename,
+               const ros::Time& start,
+               const ros::Time& end,
+               size_t batch_size,
+               const BagImportFilter* filter,
+               BatchQueue* queue,
+               const volatile bool* cancelled) :
+      filename_(filename),
+      start_(start),
+      end_(end),
+      batch_size_(batch_size),
+      filter_(filter),
+      queue_(queue),
+      cancelled_(cancelled)
+    {
+    }
+
+    void run()
+    {
+      QString error;
+      try
+      {
+        rosbag::Bag bag;
+        bag.open(filename_.toStdString(), rosbag::bagmode::Read);
+
+        rosbag::View view(bag, rosbag::TypeQuery(LOG_DATATYPE), start_, end_);
+        rosbag::View::const_iterator iter;
+
+        LogBatch batch;
+        batch.msgs.reserve(batch_size_);
+        batch.times.reserve(batch_size_);
+
+        bool accepted = true;
+        for(iter = view.begin(); iter != view.end() && accepted && !*cancelled_; ++iter)
+        {
+          rosgraph_msgs::LogConstPtr log;
+          if (filter_->acceptsAll()) {
+            log = iter->instantiate<rosgraph_msgs::Log>();
+          }
+          else if (iter->getDataType() == LOG_DATATYPE) {
+            if (!accept(*iter)) {
+              continue;
+            }
+            rosgraph_msgs::LogPtr decoded(new rosgraph_msgs::Log());
+            ros::serialization::IStream stream(&buffer_[0], buffer_.size());
+            ros::serialization::deserialize(stream, *decoded);
+            log = decoded;
+          }
+
+          if (log != NULL ) {
+            batch.msgs.push_back(log);
+            batch.times.push_back(iter->getTime());
+          }
+          else {
+            qWarning("Got a message that was not a log message but a: %s", iter->getDataType().c_str());
+          }
+
+          if (batch.msgs.size() >= batch_size_) {
+            accepted = queue_->push(batch);
+            batch.msgs.clear();
+            batch.times.clear();
+          }
+        }
+
+        if (accepted && !batch.msgs.empty()) {
+          queue_->push(batch);
+        }
+      }
+      catch (const rosbag::BagException& e)
+      {
+        error = QString::fromStdString(e.what());
+      }
+      catch (const std::exception& e)
+      {
+        // e.g. a ros::serialization::StreamOverrunException from a
+        // corrupt message.  Letting it escape would terminate the
+        // process from the pool thread.
+        error = QString::fromStdString(e.what());
+      }
+
+      queue_->close(error);
+    }
+
+  private:
+    /**
+     * Copies the serialized message into buffer_ and tests it against
+     * the filter, without deserializing it.
+     */
+    bool accept(const rosbag::MessageInstance& msg)
+    {
+      buffer_.resize(msg.size());
+      if (buffer_.empty()) {
+        return false;
+      }
+      ros::serialization::OStream stream(&buffer_[0], buffer_.size());
+      msg.write(stream);
 
-  std::vector<std::string> topics;
-  topics.push_back(std::string("/rosout"));
+      uint8_t level = 0;
+      if (!peekLevelAndName(buffer_, &level, &name_)) {
+        return false;
+      }
+      if (!(level & filter_->severity_mask)) {
+        return false;
+      }
 
-  rosbag::View view(bag, rosbag::TopicQuery(topics));
-  rosbag::View::const_iterator iter;
+      // Node names repeat constantly, so the prefix test is cached.
+      boost::unordered_map<std::string, bool>::const_iterator it = node_accepted_.find(name_);
+      if (it != node_accepted_.end()) {
+        return it->second;
+      }
+      bool accepted = filter_->acceptNode(name_);
+      node_accepted_[name_] = accepted;
+      return accepted;
+    }
+
+    QString filename_;
+    ros::Time start_;
+    ros::Time end_;
+    size_t batch_size_;
+    const BagImportFilter* filter_;
+    BatchQueue* queue_;
+    const volatile bool* cancelled_;
 
-  for(iter = view.begin(); iter != view.end(); ++iter)
+    std::vector<uint8_t> buffer_;
+    std::string name_;
+    boost::unordered_map<std::string, bool> node_accepted_;
+  };
+
+  /**
+   * The next unmerged message from one bag, ordered so that a
+   * std::priority_queue yields the earliest receipt time first.
+   */
+  struct MergeHead
   {
-    rosgraph_msgs::LogConstPtr log = iter->instantiate<rosgraph_msgs::Log>();
-    if (log != NULL ) {
-      emit logReceived(log);
+    ros::Time time;
+    size_t source;
+
+    bool operator<(const MergeHead& other) const
+    {
+      if (time != other.time) {
+        return time > other.time;
+      }
+      return source > other.source;
+    }
+  };
+}
+
+BagReaderThread::BagReaderThread(const QStringList& filenames,
+                                 const BagImportFilter& filter,
+                                 bool browse) :
+  filenames_(filenames),
+  filter_(filter),
+  browse_(browse),
+  cancelled_(false),
+  max_threads_(0),
+  last_progress_(-1)
+{
+}
+
+// Opens a bag's sidecar index.  A corrupt index is treated as missing,
+// so the bag is decoded instead.
+static QSharedPointer<BagIndex> openBagIndex(const QString& filename)
+{
+  try
+  {
+    return BagIndex::open(filename);
+  }
+  catch (const std::exception& e)
+  {
+    qWarning("Ignoring index %s: %s", bagIndexPath(filename).toStdString().c_str(), e.what());
+    return QSharedPointer<BagIndex>();
+  }
+}
+
+void BagReaderThread::cancel()
+{
+  cancelled_ = true;
+}
+
+void BagReaderThread::run()
+{
+  // A single bag that has been read before can be loaded from its
+  // sidecar index, which is much faster than decoding it again.
+  const bool use_index = filenames_.size() == 1 && filter_.acceptsAll();
+  if (use_index) {
+    QSharedPointer<BagIndex> index = openBagIndex(filenames_[0]);
+    if (index) {
+      readIndexed(filenames_[0], index);
+      return;
+    }
+  }
+
+  QStringList sources;
+  uint32_t count = 0;
+
+  for (int i = 0; i < filenames_.size(); i++) {
+    try
+    {
+      rosbag::Bag bag;
+      bag.open(filenames_[i].toStdString(), rosbag::bagmode::Read);
+
+      rosbag::View view(bag, rosbag::TypeQuery(LOG_DATATYPE));
+      if (view.size() == 0) {
+        continue;
+      }
+
+      if (sources.empty() || view.getBeginTime() < begin_) {
+        begin_ = view.getBeginTime();
+      }
+      if (sources.empty() || view.getEndTime() > end_) {
+        end_ = view.getEndTime();
+      }
+      count += view.size();
+      sources.append(filenames_[i]);
+    }
+    catch (const std::exception& e)
+    {
+      error_ = QString("%1: %2").arg(filenames_[i]).arg(QString::fromStdString(e.what()));
+      return;
+    }
+  }
+
+  if (sources.size() == 1 && use_index && browse_) {
+    // When browsing, nothing is loaded until the index is built, and
+    // then the messages are loaded from the index so that their text
+    // stays in the bag.
+    BagIndexWriter writer;
+    readPartitioned(sources[0], count, &writer, false);
+    if (cancelled_ || !error_.isEmpty()) {
+      return;
+    }
+    if (!writer.write(sources[0])) {
+      error_ = tr("Failed to write index %1").arg(bagIndexPath(sources[0]));
+      return;
+    }
+
+    QSharedPointer<BagIndex> index = openBagIndex(sources[0]);
+    if (!index) {
+      error_ = tr("Failed to open index %1").arg(bagIndexPath(sources[0]));
+      return;
+    }
+    last_progress_ = -1;
+    readIndexed(sources[0], index);
+  }
+  else if (sources.size() == 1 && use_index) {
+    BagIndexWriter writer;
+    readPartitioned(sources[0], count, &writer, true);
+    if (!cancelled_ && error_.isEmpty() && !writer.write(sources[0])) {
+      qWarning("Failed to write index for %s", sources[0].toStdString().c_str());
+    }
+  }
+  else if (sources.size() == 1) {
+    readPartitioned(sources[0], count, NULL, true);
+  }
+  else if (sources.size() > 1) {
+    readMerged(sources);
+  }
+}
+
+void BagReaderThread::readPartitioned(const QString& filename,
+                                      uint32_t count,
+                                      BagIndexWriter* writer,
+                                      bool deliver)
+{
+  // Split the bag into disjoint time ranges of about
+  // MIN_PARTITION_SIZE messages that are decoded concurrently.  The
+  // ranges are delivered in order, so the messages come out in the same
+  // order as reading the bag from start to end.
+  const int threads = max_threads_ > 0 ? max_threads_ : std::max(1, QThread::idealThreadCount());
+  int partitions = std::max<uint32_t>(1, count / MIN_PARTITION_SIZE);
+
+  const uint64_t begin_ns = begin_.toNSec();
+  const uint64_t span_ns = end_.toNSec() - begin_ns;
+  if (span_ns < static_cast<uint64_t>(partitions)) {
+    partitions = 1;
+  }
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(threads);
+
+  // Only a window of partitions ahead of the one being delivered is
+  // started, and each partition's queue is bounded, so the memory held
+  // by decoded messages doesn't depend on the size of the bag.  The
+  // pool starts tasks in order, so the partition being delivered is
+  // always running and a full queue can't deadlock.
+  const int window = threads + 1;
+  std::vector<BatchQueue*> queues;
+  for (int i = 0; i < partitions && !cancelled_; i++) {
+    while (static_cast<int>(queues.size()) < std::min(partitions, i + window)) {
+      const int p = queues.size();
+      ros::Time start;
+      start.fromNSec(begin_ns + span_ns * p / partitions);
+      // View time ranges are inclusive, so each range stops just short
+      // of where the next one starts.
+      ros::Time stop = end_;
+      if (p + 1 < partitions) {
+        stop.fromNSec(begin_ns + span_ns * (p + 1) / partitions - 1);
+      }
+
+      queues.push_back(new BatchQueue(PARTITION_QUEUE_DEPTH));
+      pool.start(new DecodeTask(filename, start, stop, BATCH_SIZE, &filter_,
+                                queues.back(), &cancelled_));
+    }
+
+    LogBatch batch;
+    while (!cancelled_ && queues[i]->pop(batch)) {
+      const ros::Time batch_time = batch.times.back();
+      removeDuplicates(&batch.msgs, batch_time, &batch.times);
+      if (deliver && !batch.msgs.empty()) {
+        emit messagesRead(batch.msgs);
+      }
+      if (writer) {
+        for (size_t j = 0; j < batch.msgs.size(); j++) {
+          writer->add(*batch.msgs[j], batch.times[j]);
+        }
+      }
+      reportProgress(batch_time);
+    }
+
+    if (error_.isEmpty()) {
+      error_ = queues[i]->error();
+    }
+  }
+
+  // If we were cancelled, the tasks notice the flag and stop early;
+  // any that are waiting on a full queue are released.
+  for (size_t i = 0; i < queues.size(); i++) {
+    queues[i]->abort();
+  }
+  pool.waitForDone();
+  for (size_t i = 0; i < queues.size(); i++) {
+    delete queues[i];
+  }
+}
+
+void BagReaderThread::readMerged(const QStringList& filenames)
+{
+  // Every bag is decoded by its own task into a bounded queue, and the
+  // queues are combined with a k-way merge on receipt time.  The pool
+  // needs a thread per bag, because the merge may wait on any of them.
+  const size_t k = filenames.size();
+  const size_t batch_size = std::max(MIN_MERGE_BATCH_SIZE, BATCH_SIZE / k);
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(k);
+
+  std::vector<BatchQueue*> queues;
+  for (size_t i = 0; i < k; i++) {
+    queues.push_back(new BatchQueue(MERGE_QUEUE_DEPTH));
+    pool.start(new DecodeTask(filenames[i], ros::TIME_MIN, ros::TIME_MAX,
+                              batch_size, &filter_, queues.back(), &cancelled_));
+  }
+
+  std::vector<LogBatch> current(k);
+  std::vector<size_t> position(k, 0);
+  std::priority_queue<MergeHead> heads;
+
+  for (size_t i = 0; i < k; i++) {
+    if (queues[i]->pop(current[i])) {
+      MergeHead head;
+      head.time = current[i].times[0];
+      head.source = i;
+      heads.push(head);
+    }
+  }
+
+  MessageList output;
+  output.reserve(BATCH_SIZE);
+  ros::Time output_time;
+
+  while (!heads.empty() && !cancelled_) {
+    const size_t i = heads.top().source;
+    heads.pop();
+
+    output.push_back(current[i].msgs[position[i]]);
+    output_time = current[i].times[position[i]];
+    position[i]++;
+
+    if (position[i] >= current[i].msgs.size()) {
+      position[i] = 0;
+      if (!queues[i]->pop(current[i])) {
+        current[i] = LogBatch();
+      }
+    }
+
+    if (position[i] < current[i].msgs.size()) {
+      MergeHead head;
+      head.time = current[i].times[position[i]];
+      head.source = i;
+      heads.push(head);
+    }
+
+    if (output.size() >= BATCH_SIZE) {
+      removeDuplicates(&output, output_time);
+      if (!output.empty()) {
+        emit messagesRead(output);
+      }
+      reportProgress(output_time);
+      output.clear();
+    }
+  }
+
+  removeDuplicates(&output, output_time);
+  if (!output.empty() && !cancelled_) {
+    emit messagesRead(output);
+  }
+
+  for (size_t i = 0; i < k; i++) {
+    queues[i]->abort();
+  }
+  pool.waitForDone();
+
+  for (size_t i = 0; i < k; i++) {
+    if (error_.isEmpty() && !queues[i]->error().isEmpty()) {
+      error_ = QString("%1: %2").arg(filenames[i]).arg(queues[i]->error());
+    }
+    delete queues[i];
+  }
+}
+
+void BagReaderThread::readIndexed(const QString& filename,
+                                  const QSharedPointer<BagIndex>& index)
+{
+  IndexedMessageBatch batch;
+  batch.source = QSharedPointer<LogBodySource>(new BagBodySource(filename, index));
+
+  for (size_t row = 0; row < index->size() && !cancelled_; row++) {
+    IndexedMessage msg;
+    index->message(row, &msg);
+    batch.msgs.push_back(msg);
+
+    if (batch.msgs.size() >= BATCH_SIZE || row + 1 == index->size()) {
+      emit indexedMessagesRead(batch);
+      batch.msgs.clear();
+
+      const int permille = static_cast<int>(1000.0 * (row + 1) / index->size());
+      if (permille != last_progress_) {
+        last_progress_ = permille;
+        emit progress(permille);
+      }
     }
-    else {
-      qWarning("Got a message that was not a log message but a: %s", iter->getDataType().c_str());
+  }
+}
+
+void BagReaderThread::removeDuplicates(MessageList* msgs, const ros::Time& batch_time,
+                                       std::vector<ros::Time>* times)
+{
+  // Batches arrive in receipt order, so once a generation covers a
+  // whole window, the generation before it can't match anything.
+  if (seen_start_.isZero()) {
+    seen_start_ = batch_time;
+  } else if (batch_time - seen_start_ > ros::Duration(FINGERPRINT_WINDOW)) {
+    seen_previous_.swap(seen_);
+    seen_.clear();
+    seen_start_ = batch_time;
+  }
+
+  // The same message is often recorded on more than one topic (e.g.
+  // both /rosout and /rosout_agg).  roscpp assigns each publication its
+  // own seq, so copies are identified by node, stamp and content
+  // instead.  Only a 64-bit fingerprint of each is kept.
+  size_t kept = 0;
+  for (size_t i = 0; i < msgs->size(); i++) {
+    const rosgraph_msgs::Log& log = *(*msgs)[i];
+
+    size_t seed = 0;
+    boost::hash_combine(seed, log.name);
+    boost::hash_combine(seed, log.header.stamp.sec);
+    boost::hash_combine(seed, log.header.stamp.nsec);
+    boost::hash_combine(seed, log.msg);
+    boost::hash_combine(seed, log.file);
+    boost::hash_combine(seed, log.line);
+
+    if (!insertFingerprint(seed)) {
+      continue;
+    }
+    if (times) {
+      (*times)[kept] = (*times)[i];
+    }
+    (*msgs)[kept++] = (*msgs)[i];
+  }
+  msgs->resize(kept);
+  if (times) {
+    times->resize(kept);
+  }
+}
+
+bool BagReaderThread::insertFingerprint(quint64 fingerprint)
+{
+  // Zero marks an empty slot.
+  if (fingerprint == 0) {
+    fingerprint = 1;
+  }
+
+  if (seen_.contains(fingerprint) || seen_previous_.contains(fingerprint)) {
+    return false;
+  }
+  seen_.insert(fingerprint);
+  return true;
+}
+
+bool BagReaderThread::FingerprintSet::contains(quint64 fingerprint) const
+{
+  if (slots_.empty()) {
+    return false;
+  }
+
+  const size_t mask = slots_.size() - 1;
+  size_t slot = fingerprintSlot(fingerprint, mask);
+  while (slots_[slot] != 0) {
+    if (slots_[slot] == fingerprint) {
+      return true;
+    }
+    slot = (slot + 1) & mask;
+  }
+  return false;
+}
+
+void BagReaderThread::FingerprintSet::insert(quint64 fingerprint)
+{
+  // Grow the table when it is half full.
+  if ((count_ + 1) * 2 > slots_.size()) {
+    std::vector<quint64> old;
+    old.swap(slots_);
+    slots_.resize(std::max<size_t>(MIN_FINGERPRINT_SLOTS, old.size() * 2), 0);
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = 0; i < old.size(); i++) {
+      if (old[i] != 0) {
+        size_t slot = fingerprintSlot(old[i], mask);
+        while (slots_[slot] != 0) {
+          slot = (slot + 1) & mask;
+        }
+        slots_[slot] = old[i];
+      }
+    }
+  }
+
+  const size_t mask = slots_.size() - 1;
+  size_t slot = fingerprintSlot(fingerprint, mask);
+  while (slots_[slot] != 0) {
+    if (slots_[slot] == fingerprint) {
+      return;
     }
+    slot = (slot + 1) & mask;
+  }
+  slots_[slot] = fingerprint;
+  count_++;
+}
+
+void BagReaderThread::FingerprintSet::clear()
+{
+  std::vector<quint64>().swap(slots_);
+  count_ = 0;
+}
+
+void BagReaderThread::FingerprintSet::swap(FingerprintSet& other)
+{
+  slots_.swap(other.slots_);
+  std::swap(count_, other.count_);
+}
+
+void BagReaderThread::reportProgress(const ros::Time& time)
+{
+  int permille = 1000;
+  const double duration = (end_ - begin_).toSec();
+  if (duration > 0.0) {
+    permille = static_cast<int>(1000.0 * (time - begin_).toSec() / duration);
+  }
+  if (permille != last_progress_) {
+    last_progress_ = permille;
+    emit progress(permille);
+  }
+}
+
+BagReader::BagReader() :
+  thread_(NULL),
+  progress_dialog_(NULL)
+{
+}
+
+BagReader::~BagReader()
+{
+  if (thread_)
+  {
+    thread_->cancel();
+    thread_->wait();
+    delete thread_;
+  }
+  delete progress_dialog_;
+}
+
+void BagReader::readBagFile(const QString& filename)
+{
+  readBagFiles(QStringList(filename));
+}
+
+void BagReader::readBagFiles(const QStringList& filenames,
+                             const BagImportFilter& filter)
+{
+  startReading(filenames, filter, false);
+}
+
+void BagReader::browseBagFile(const QString& filename)
+{
+  startReading(QStringList(filename), BagImportFilter(), true);
+}
+
+void BagReader::startReading(const QStringList& filenames,
+                             const BagImportFilter& filter,
+                             bool browse)
+{
+  if (thread_)
+  {
+    QMessageBox::information(NULL, tr("Read Bag File"),
+                             tr("A bag file is already being read."));
+    return;
+  }
+
+  thread_ = new BagReaderThread(filenames, filter, browse);
+  // Batches are emitted from the reader thread, so these connections
+  // are queued and the batches are delivered on the GUI thread.
+  QObject::connect(thread_, SIGNAL(messagesRead(const MessageList&)),
+                   this, SIGNAL(logsReceived(const MessageList&)));
+  QObject::connect(thread_, SIGNAL(indexedMessagesRead(const IndexedMessageBatch&)),
+                   this, SIGNAL(indexedLogsReceived(const IndexedMessageBatch&)));
+  QObject::connect(thread_, SIGNAL(finished()),
+                   this, SLOT(handleThreadFinished()));
+
+  QString label = tr("Reading %1...").arg(filenames[0]);
+  if (filenames.size() > 1)
+  {
+    label = tr("Reading %1 bag files...").arg(filenames.size());
+  }
+  progress_dialog_ = new QProgressDialog(label, tr("Cancel"), 0, 1000);
+  progress_dialog_->setMinimumDuration(500);
+  QObject::connect(thread_, SIGNAL(progress(int)),
+                   progress_dialog_, SLOT(setValue(int)));
+  QObject::connect(progress_dialog_, SIGNAL(canceled()),
+                   this, SLOT(cancelReading()));
+
+  thread_->start();
+}
+
+void BagReader::cancelReading()
+{
+  if (thread_)
+  {
+    thread_->cancel();
+  }
+}
+
+void BagReader::handleThreadFinished()
+{
+  QString error = thread_->errorString();
+  thread_->deleteLater();
+  thread_ = NULL;
+  progress_dialog_->deleteLater();
+  progress_dialog_ = NULL;
+
+  if (!error.isEmpty())
+  {
+    QMessageBox::warning(NULL, tr("Read Bag File"),
+                         tr("Failed to read bag file: %1").arg(error));
   }
 
   emit finishedReading();
 }
 
 void BagReader::promptForBagFile()
+{
+  promptForFilteredBagFile(BagImportFilter());
+}
+
+void BagReader::promptForFilteredBagFile(const BagImportFilter& filter)
+{
+  QStringList filenames = QFileDialog::getOpenFileNames(NULL,
+                                                        tr("Open Bag Files"),
+                                                        QDir::homePath(),
+                                                        tr("Bag Files (*.bag)"));
+
+  if (!filenames.isEmpty())
+  {
+    readBagFiles(filenames, filter);
+  }
+}
+
+void BagReader::promptForBrowseBagFile()
 {
   QString filename = QFileDialog::getOpenFileName(NULL,
-                                                  tr("Open Bag File"),
+                                                  tr("Browse Bag File"),
                                                   QDir::homePath(),
                                                   tr("Bag Files (*.bag)"));
 
-  if (filename != NULL)
+  if (!filename.isEmpty())
   {
-    readBagFile(filename);
+    browseBagFile(filename);
   }
 }
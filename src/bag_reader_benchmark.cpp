@@ -0,0 +1,128 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+// Measures how bag decoding scales with the number of threads.  A
+// synthetic bag of /rosout messages is written to a temporary directory
+// and read once for each thread count from 1 to the number of cores.
+//
+//   swri_console_bag_benchmark [message_count]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <swri_console/bag_index.h>
+#include <swri_console/bag_reader.h>
+
+#include <rosbag/bag.h>
+
+static void writeBag(const QString& filename, int count)
+{
+  static const char* const NODES[] = { "/planner", "/controller", "/localization", "/camera_driver" };
+  static const int NODE_COUNT = sizeof(NODES) / sizeof(NODES[0]);
+
+  rosbag::Bag bag;
+  bag.open(filename.toStdString(), rosbag::bagmode::Write);
+
+  ros::Time stamp(1000, 0);
+  for (int i = 0; i < count; i++) {
+    rosgraph_msgs::Log msg;
+    msg.header.seq = i;
+    msg.header.stamp = stamp;
+    msg.level = rosgraph_msgs::Log::INFO;
+    msg.name = NODES[i % NODE_COUNT];
+    msg.msg = QString("Processed frame %1 in %2 ms").arg(i).arg(i % 97).toStdString();
+    msg.file = "benchmark.cpp";
+    msg.function = "writeBag";
+    msg.line = 42;
+    bag.write("/rosout_agg", stamp, msg);
+    stamp += ros::Duration(0, 1000000);
+  }
+  bag.close();
+}
+
+int main(int argc, char **argv)
+{
+  QCoreApplication app(argc, argv);
+  ros::Time::init();
+
+  const int count = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  if (count <= 0) {
+    std::fprintf(stderr, "usage: %s [message_count]\n", argv[0]);
+    return 1;
+  }
+
+  QTemporaryDir dir;
+  if (!dir.isValid()) {
+    std::fprintf(stderr, "Failed to create a temporary directory\n");
+    return 1;
+  }
+  const QString filename = dir.path() + "/benchmark.bag";
+
+  std::printf("Writing %d messages to %s\n", count, filename.toStdString().c_str());
+  writeBag(filename, count);
+
+  double single = 0.0;
+  const int max_threads = std::max(1, QThread::idealThreadCount());
+  for (int threads = 1; threads <= max_threads; threads++) {
+    // Reading a bag writes its sidecar index, which later runs would
+    // load instead of decoding the bag.
+    QFile::remove(swri_console::bagIndexPath(filename));
+
+    swri_console::BagReaderThread reader(QStringList() << filename);
+    reader.setMaxThreads(threads);
+
+    QElapsedTimer timer;
+    timer.start();
+    reader.start();
+    reader.wait();
+    const double seconds = timer.nsecsElapsed() / 1e9;
+
+    if (!reader.errorString().isEmpty()) {
+      std::fprintf(stderr, "%s\n", reader.errorString().toStdString().c_str());
+      return 1;
+    }
+
+    if (threads == 1) {
+      single = seconds;
+    }
+    std::printf("%2d threads: %7.3f s  %10.0f msgs/s  speedup %.2fx\n",
+                threads, seconds, count / seconds, single / seconds);
+  }
+
+  return 0;
+}
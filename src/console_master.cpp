@@ -30,10 +30,17 @@
 
 #include <swri_console/console_master.h>
 #include <swri_console/console_window.h>
+#include <swri_console/session_file.h>
 #include <swri_console/settings_keys.h>
 
+#include <QDir>
+#include <QFile>
+#include <QFileDialog>
 #include <QFontDialog>
+#include <QInputDialog>
+#include <QMessageBox>
 #include <QSettings>
+#include <QUrl>
 
 namespace swri_console
 {
@@ -47,17 +54,82 @@ ConsoleMaster::ConsoleMaster(int argc, char** argv):
   // In order for that to work, we have to manually register the message type with
   // Qt's QMetaType system.
   qRegisterMetaType<rosgraph_msgs::LogConstPtr>("rosgraph_msgs::LogConstPtr");
+  qRegisterMetaType<MessageList>("MessageList");
+  qRegisterMetaType<RosoutMessageList>("RosoutMessageList");
+  qRegisterMetaType<IndexedMessageBatch>("IndexedMessageBatch");
+  qRegisterMetaType<RosoutPathStatistics>("RosoutPathStatistics");
 
-  QObject::connect(&bag_reader_, SIGNAL(logReceived(const rosgraph_msgs::LogConstPtr& )),
-                   &db_, SLOT(queueMessage(const rosgraph_msgs::LogConstPtr&) ));
-  QObject::connect(&bag_reader_, SIGNAL(finishedReading()),
+  // Bag files are read in the background and delivered in batches;
+  // each batch is processed as soon as it arrives so that the
+  // messages show up while the rest of the bag is being read.
+  QObject::connect(&bag_reader_, SIGNAL(logsReceived(const MessageList&)),
+                   &db_, SLOT(queueMessages(const MessageList&)));
+  QObject::connect(&bag_reader_, SIGNAL(logsReceived(const MessageList&)),
                    &db_, SLOT(processQueue()));
+  QObject::connect(&bag_reader_, SIGNAL(indexedLogsReceived(const IndexedMessageBatch&)),
+                   &db_, SLOT(queueIndexedMessages(const IndexedMessageBatch&)));
+  QObject::connect(&bag_reader_, SIGNAL(indexedLogsReceived(const IndexedMessageBatch&)),
+                   &db_, SLOT(processQueue()));
+  QObject::connect(&text_log_reader_, SIGNAL(logsReceived(const MessageList&)),
+                   &db_, SLOT(queueMessages(const MessageList&)));
+  QObject::connect(&text_log_reader_, SIGNAL(logsReceived(const MessageList&)),
+                   &db_, SLOT(processQueue()));
+
+  follower_ = new LogDirectoryFollower();
+  follower_->moveToThread(&follow_thread_);
+  QObject::connect(this, SIGNAL(followDirectory(const QString&)),
+                   follower_, SLOT(follow(const QString&)));
+  QObject::connect(this, SIGNAL(stopFollowing()),
+                   follower_, SLOT(stop()));
+  QObject::connect(follower_, SIGNAL(messagesRead(const MessageList&)),
+                   &db_, SLOT(queueLiveMessages(const MessageList&)));
+  QObject::connect(follower_, SIGNAL(messagesRead(const MessageList&)),
+                   &db_, SLOT(processQueue()));
+
+  // The journal only queues messages on the calling thread, so it is
+  // fed directly from the ROS thread.
+  QObject::connect(&ros_thread_, SIGNAL(logsReceived(const RosoutMessageList&)),
+                   &journal_, SLOT(append(const RosoutMessageList&)),
+                   Qt::DirectConnection);
+  QObject::connect(&db_, SIGNAL(databaseCleared()),
+                   &journal_, SLOT(reset()));
+
+  // A journal that is still around is left over from a run that didn't
+  // exit cleanly.  Keep it for recovery before starting a new one.
+  if (QFile::exists(SessionJournal::journalPath())) {
+    QFile::remove(SessionJournal::previousJournalPath());
+    QFile::rename(SessionJournal::journalPath(), SessionJournal::previousJournalPath());
+  }
+
+  QSettings settings;
+  setJournalSession(settings.value(SettingsKeys::JOURNAL_SESSION, false).toBool());
+  ros_thread_.setSubscribeRosout(settings.value(SettingsKeys::SUBSCRIBE_ROSOUT, false).toBool());
 }
 
 ConsoleMaster::~ConsoleMaster()
 {
   ros_thread_.shutdown();
   ros_thread_.wait();
+
+  follow_thread_.quit();
+  follow_thread_.wait();
+  delete follower_;
+
+  for (int i = 0; i < source_threads_.size(); i++) {
+    // The relay process belongs to the source's thread, so it has to
+    // be stopped there.
+    QMetaObject::invokeMethod(sources_[i], "stop", Qt::BlockingQueuedConnection);
+    source_threads_[i]->quit();
+    source_threads_[i]->wait();
+    delete sources_[i];
+    delete source_threads_[i];
+  }
+
+  // We exited cleanly, so there's nothing to recover.
+  if (journal_.isOpen()) {
+    journal_.close();
+    QFile::remove(SessionJournal::journalPath());
+  }
 }
 
 void ConsoleMaster::createNewWindow()
@@ -84,14 +156,44 @@ void ConsoleMaster::createNewWindow()
   QObject::connect(win, SIGNAL(readBagFile()),
                    &bag_reader_, SLOT(promptForBagFile()));
 
+  QObject::connect(win, SIGNAL(readFilteredBagFile(const BagImportFilter&)),
+                   &bag_reader_, SLOT(promptForFilteredBagFile(const BagImportFilter&)));
+
+  QObject::connect(win, SIGNAL(browseBagFile()),
+                   &bag_reader_, SLOT(promptForBrowseBagFile()));
+
+  QObject::connect(win, SIGNAL(openTextLogs()),
+                   &text_log_reader_, SLOT(promptForTextLogs()));
+
+  QObject::connect(win, SIGNAL(followLogDirectory()),
+                   this, SLOT(followLogDirectory()));
+
+  QObject::connect(win, SIGNAL(addRosMaster()),
+                   this, SLOT(addRosMaster()));
+
+  QObject::connect(win, SIGNAL(openSession()),
+                   this, SLOT(openSession()));
+
+  QObject::connect(win, SIGNAL(journalSessionChanged(bool)),
+                   this, SLOT(setJournalSession(bool)));
+
+  QObject::connect(win, SIGNAL(recoverSession()),
+                   this, SLOT(recoverSession()));
+
+  QObject::connect(win, SIGNAL(subscribeRosoutChanged(bool)),
+                   this, SLOT(setSubscribeRosout(bool)));
+
+  QObject::connect(&ros_thread_, SIGNAL(pathStatistics(const RosoutPathStatistics&)),
+                   win, SLOT(showPathStatistics(const RosoutPathStatistics&)));
+
 
   if (!ros_thread_.isRunning())
   {
     // There's only one ROS thread, and it services every window.  We need to initialize
     // it and its connections to the LogDatabase when we first create a window, but
     // after that it doesn't need to be modified again.
-    QObject::connect(&ros_thread_, SIGNAL(logReceived(const rosgraph_msgs::LogConstPtr& )),
-                     &db_, SLOT(queueMessage(const rosgraph_msgs::LogConstPtr&) ));
+    QObject::connect(&ros_thread_, SIGNAL(logsReceived(const RosoutMessageList&)),
+                     &db_, SLOT(queueRosoutMessages(const RosoutMessageList&)));
 
     QObject::connect(&ros_thread_, SIGNAL(spun()),
                      &db_, SLOT(processQueue()));
@@ -100,6 +202,15 @@ void ConsoleMaster::createNewWindow()
   }
 
   win->show();
+
+  if (windows_.size() == 1 && QFile::exists(SessionJournal::previousJournalPath())) {
+    QMessageBox::StandardButton answer = QMessageBox::question(
+      win, tr("Recover Session"),
+      tr("The previous session did not exit cleanly.  Recover its messages?"));
+    if (answer == QMessageBox::Yes) {
+      recoverSession();
+    }
+  }
 }
 
 void ConsoleMaster::fontSelectionChanged(const QFont &font)
@@ -133,4 +244,163 @@ void ConsoleMaster::selectFont()
     }
   }
 }
+
+void ConsoleMaster::setJournalSession(bool journal)
+{
+  if (journal == journal_.isOpen()) {
+    return;
+  }
+
+  if (journal) {
+    if (!journal_.open(SessionJournal::journalPath())) {
+      qWarning("Failed to open session journal %s",
+               SessionJournal::journalPath().toStdString().c_str());
+    }
+  } else {
+    journal_.close();
+    QFile::remove(SessionJournal::journalPath());
+  }
+}
+
+void ConsoleMaster::setSubscribeRosout(bool subscribe)
+{
+  ros_thread_.setSubscribeRosout(subscribe);
+}
+
+void ConsoleMaster::followLogDirectory()
+{
+  if (!followed_directory_.isEmpty()) {
+    QMessageBox::StandardButton answer = QMessageBox::question(
+      NULL, tr("Follow Log Directory"),
+      tr("Stop following %1?").arg(followed_directory_));
+    if (answer == QMessageBox::Yes) {
+      Q_EMIT stopFollowing();
+      followed_directory_.clear();
+    }
+    return;
+  }
+
+  QString directory = QFileDialog::getExistingDirectory(
+    NULL, tr("Follow Log Directory"),
+    QDir::homePath() + "/.ros/log/latest");
+  if (directory.isEmpty()) {
+    return;
+  }
+
+  if (!follow_thread_.isRunning()) {
+    follow_thread_.start();
+  }
+  followed_directory_ = directory;
+  Q_EMIT followDirectory(directory);
+}
+
+void ConsoleMaster::addRosMaster()
+{
+  bool ok = false;
+  QString uri = QInputDialog::getText(
+    NULL, tr("Add ROS Master"),
+    tr("Master URI:"), QLineEdit::Normal, "http://localhost:11311", &ok).trimmed();
+  if (!ok || uri.isEmpty()) {
+    return;
+  }
+
+  // The master's host names the source, and the namespace of its
+  // nodes.  Masters on the same host are told apart by their port, and
+  // after that by a number.
+  QUrl url(uri);
+  const std::string host = url.host().toStdString();
+  if (host.empty()) {
+    QMessageBox::warning(NULL, tr("Add ROS Master"),
+                         tr("%1 is not a valid master URI.").arg(uri));
+    return;
+  }
+
+  std::vector<std::string> candidates;
+  candidates.push_back(host);
+  if (url.port() >= 0) {
+    candidates.push_back(host + "_" + QString::number(url.port()).toStdString());
+  }
+  std::string name;
+  for (int i = 0; name.empty(); i++) {
+    const std::string candidate = static_cast<size_t>(i) < candidates.size() ?
+      candidates[i] :
+      candidates.back() + "_" + QString::number(i - candidates.size() + 2).toStdString();
+    bool taken = false;
+    for (size_t j = 0; j < db_.sourceCount() && !taken; j++) {
+      taken = db_.sourceName(j) == candidate;
+    }
+    if (!taken) {
+      name = candidate;
+    }
+  }
+
+  const int source_id = db_.addSource(name);
+  journal_.setSourceName(source_id, name);
+  QThread* thread = new QThread();
+  MasterSource* source = new MasterSource(source_id, uri);
+  source->moveToThread(thread);
+  QObject::connect(thread, SIGNAL(started()),
+                   source, SLOT(start()));
+  QObject::connect(source, SIGNAL(logsReceived(int, const RosoutMessageList&)),
+                   &db_, SLOT(queueSourceMessages(int, const RosoutMessageList&)));
+  QObject::connect(source, SIGNAL(logsReceived(int, const RosoutMessageList&)),
+                   &db_, SLOT(processQueue()));
+  QObject::connect(source, SIGNAL(logsReceived(int, const RosoutMessageList&)),
+                   &journal_, SLOT(append(int, const RosoutMessageList&)),
+                   Qt::DirectConnection);
+  source_threads_.append(thread);
+  sources_.append(source);
+  thread->start();
+}
+
+void ConsoleMaster::recoverSession()
+{
+  MessageList msgs;
+  if (!SessionJournal::recover(SessionJournal::previousJournalPath(), &msgs) || msgs.empty()) {
+    QMessageBox::information(NULL, tr("Recover Session"),
+                             tr("There are no messages to recover."));
+    return;
+  }
+
+  // Journal the recovered messages again, in case we don't exit
+  // cleanly this time either.
+  journal_.append(msgs);
+  db_.queueMessages(msgs);
+  db_.processQueue();
+}
+
+void ConsoleMaster::openSession()
+{
+  QString filename = QFileDialog::getOpenFileName(NULL,
+                                                  tr("Open Session"),
+                                                  QDir::homePath(),
+                                                  tr("Session Files (*.swcs)"));
+  if (filename.isEmpty()) {
+    return;
+  }
+
+  QSharedPointer<SessionFile> session = SessionFile::open(filename);
+  if (!session) {
+    QMessageBox::warning(NULL, tr("Open Session"),
+                         tr("Failed to open session file %1").arg(filename));
+    return;
+  }
+
+  // The session stays mapped for as long as its entries are in the
+  // database, and their text is read from it directly.
+  IndexedMessageBatch batch;
+  batch.source = session;
+  const size_t batch_size = 10000;
+  for (size_t row = 0; row < session->size(); row++) {
+    IndexedMessage msg;
+    session->message(row, &msg);
+    batch.msgs.push_back(msg);
+
+    if (batch.msgs.size() >= batch_size || row + 1 == session->size()) {
+      db_.queueIndexedMessages(batch);
+      db_.processQueue();
+      batch.msgs.clear();
+    }
+  }
+}
 }  // namespace swri_console
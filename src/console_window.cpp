@@ -30,6 +30,8 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <algorithm>
+#include <cmath>
 #include <set>
 
 #include <rosgraph_msgs/Log.h>
@@ -39,18 +41,29 @@
 #include <swri_console/console_window.h>
 #include <swri_console/log_database.h>
 #include <swri_console/log_database_proxy_model.h>
-#include <swri_console/node_list_model.h>
+#include <swri_console/node_tree_model.h>
 #include <swri_console/settings_keys.h>
+#include <swri_console/template_list_model.h>
 
 #include <QColorDialog>
 #include <QRegExp>
 #include <QApplication>
 #include <QClipboard>
 #include <QDateTime>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QDoubleSpinBox>
 #include <QFileDialog>
 #include <QDir>
+#include <QDockWidget>
+#include <QFormLayout>
+#include <QInputDialog>
+#include <QLabel>
+#include <QListView>
 #include <QScrollBar>
+#include <QSpinBox>
 #include <QMenu>
+#include <QMessageBox>
 #include <QSettings>
 
 using namespace Qt;
@@ -62,10 +75,43 @@ ConsoleWindow::ConsoleWindow(LogDatabase *db)
   QMainWindow(),
   db_(db),
   db_proxy_(new LogDatabaseProxyModel(db)),
-  node_list_model_(new NodeListModel(db))
+  node_tree_model_(new NodeTreeModel(db)),
+  template_list_model_(new TemplateListModel(db))
 {
   ui.setupUi(this); 
 
+  // The template view is a dock so that it can be hidden when it
+  // isn't needed; it starts out hidden.
+  QDockWidget *template_dock = new QDockWidget(tr("Message Templates"), this);
+  template_dock->setObjectName("templateDock");
+  template_list_ = new QListView(template_dock);
+  template_list_->setModel(template_list_model_);
+  template_list_->setUniformItemSizes(true);
+  template_list_->setSelectionMode(QAbstractItemView::ExtendedSelection);
+  template_dock->setWidget(template_list_);
+  addDockWidget(Qt::BottomDockWidgetArea, template_dock);
+  template_dock->hide();
+  ui.menuOptions->addAction(template_dock->toggleViewAction());
+
+  path_statistics_label_ = new QLabel(this);
+  path_statistics_label_->hide();
+  statusBar()->addPermanentWidget(path_statistics_label_);
+
+  memory_usage_label_ = new QLabel(this);
+  memory_usage_label_->hide();
+  statusBar()->addPermanentWidget(memory_usage_label_);
+
+  QObject::connect(
+    template_list_->selectionModel(),
+    SIGNAL(selectionChanged(const QItemSelection &,
+                            const QItemSelection &)),
+    this,
+    SLOT(templateSelectionChanged()));
+  // Clearing the database removes all templates, which resets the
+  // model without emitting selectionChanged.
+  QObject::connect(template_list_model_, SIGNAL(modelReset()),
+                   this, SLOT(templateSelectionChanged()));
+
   QObject::connect(ui.action_NewWindow, SIGNAL(triggered(bool)),
                    this, SIGNAL(createNewWindow()));
 
@@ -81,9 +127,36 @@ ConsoleWindow::ConsoleWindow(LogDatabase *db)
   QObject::connect(ui.action_ReadBagFile, SIGNAL(triggered(bool)),
                    this, SIGNAL(readBagFile()));
 
+  QObject::connect(ui.action_ReadBagFileFiltered, SIGNAL(triggered(bool)),
+                   this, SLOT(promptFilteredBagImport()));
+
+  QObject::connect(ui.action_BrowseBagFile, SIGNAL(triggered(bool)),
+                   this, SIGNAL(browseBagFile()));
+
+  QObject::connect(ui.action_OpenTextLogs, SIGNAL(triggered(bool)),
+                   this, SIGNAL(openTextLogs()));
+
+  QObject::connect(ui.action_FollowLogDirectory, SIGNAL(triggered(bool)),
+                   this, SIGNAL(followLogDirectory()));
+
+  QObject::connect(ui.action_AddRosMaster, SIGNAL(triggered(bool)),
+                   this, SIGNAL(addRosMaster()));
+
+  QObject::connect(ui.action_OpenSession, SIGNAL(triggered(bool)),
+                   this, SIGNAL(openSession()));
+
+  QObject::connect(ui.action_RecoverSession, SIGNAL(triggered(bool)),
+                   this, SIGNAL(recoverSession()));
+
   QObject::connect(ui.action_SaveLogs, SIGNAL(triggered(bool)),
                    this, SLOT(saveLogs()));
 
+  QObject::connect(ui.action_SaveSelectedLogs, SIGNAL(triggered(bool)),
+                   this, SLOT(saveSelectedLogs()));
+
+  QObject::connect(ui.action_SaveTimeRange, SIGNAL(triggered(bool)),
+                   this, SLOT(saveTimeRange()));
+
   QObject::connect(ui.action_AbsoluteTimestamps, SIGNAL(toggled(bool)),
                    db_proxy_, SLOT(setAbsoluteTime(bool)));
 
@@ -105,6 +178,24 @@ ConsoleWindow::ConsoleWindow(LogDatabase *db)
   QObject::connect(ui.action_ColorizeLogs, SIGNAL(toggled(bool)),
                    db_proxy_, SLOT(setColorizeLogs(bool)));
 
+  QObject::connect(ui.action_CollapseRepeats, SIGNAL(toggled(bool)),
+                   this, SLOT(setCollapseRepeats(bool)));
+
+  QObject::connect(ui.action_BodyCacheSize, SIGNAL(triggered(bool)),
+                   this, SLOT(selectBodyCacheSize()));
+
+  QObject::connect(ui.action_LimitRate, SIGNAL(triggered(bool)),
+                   this, SLOT(selectRateLimit()));
+
+  QObject::connect(ui.action_MemoryBudget, SIGNAL(triggered(bool)),
+                   this, SLOT(selectMemoryBudget()));
+
+  QObject::connect(ui.action_JournalSession, SIGNAL(toggled(bool)),
+                   this, SLOT(setJournalSession(bool)));
+
+  QObject::connect(ui.action_SubscribeRosout, SIGNAL(toggled(bool)),
+                   this, SLOT(setSubscribeRosout(bool)));
+
   QObject::connect(ui.debugColorWidget, SIGNAL(clicked(bool)),
                    this, SLOT(setDebugColor()));
   QObject::connect(ui.infoColorWidget, SIGNAL(clicked(bool)),
@@ -116,7 +207,7 @@ ConsoleWindow::ConsoleWindow(LogDatabase *db)
   QObject::connect(ui.fatalColorWidget, SIGNAL(clicked(bool)),
                    this, SLOT(setFatalColor()));
 
-  ui.nodeList->setModel(node_list_model_);  
+  ui.nodeList->setModel(node_tree_model_);  
   ui.messageList->setModel(db_proxy_);
   ui.messageList->setUniformItemSizes(true);
 
@@ -192,12 +283,13 @@ ConsoleWindow::ConsoleWindow(LogDatabase *db)
 ConsoleWindow::~ConsoleWindow()
 {
   delete db_proxy_;
+  delete template_list_model_;
 }
 
 void ConsoleWindow::clearAll()
 {
   db_->clear();
-  node_list_model_->clear();
+  node_tree_model_->clear();
   db_proxy_->clearSearchFailure();  // resets failed search variables, VCM 27 April 2017
 }
 
@@ -207,15 +299,112 @@ void ConsoleWindow::clearMessages()
   db_proxy_->clearSearchFailure();  // resets failed search variables, VCM 27 April 2017
 }
 
-void ConsoleWindow::saveLogs()
+QString ConsoleWindow::promptForExportFile()
 {
   QString defaultname = QDateTime::currentDateTime().toString(Qt::ISODate) + ".bag";
-  QString filename = QFileDialog::getSaveFileName(this,
-                                                  "Save Logs",
-                                                  QDir::homePath() + QDir::separator() + defaultname,
-                                                  tr("Bag Files (*.bag);;Text Files (*.txt)"));
-  if (filename != NULL && !filename.isEmpty()) {
-    db_proxy_->saveToFile(filename);
+  // The export job decides the format from the name, including what
+  // to do with names like "run.bag.gz".
+  return QFileDialog::getSaveFileName(this,
+                                      "Save Logs",
+                                      QDir::homePath() + QDir::separator() + defaultname,
+                                      tr("Bag Files (*.bag);;"
+                                         "Session Files (*.swcs);;"
+                                         "Text Files (*.txt);;"
+                                         "JSON Lines (*.jsonl);;"
+                                         "CSV Files (*.csv);;"
+                                         "Compressed Files (*.txt.gz *.jsonl.gz *.csv.gz)"));
+}
+
+void ConsoleWindow::saveLogs()
+{
+  QString filename = promptForExportFile();
+  if (!filename.isEmpty()) {
+    exporter_.exportLogs(db_proxy_->exportJob(filename));
+  }
+}
+
+void ConsoleWindow::saveSelectedLogs()
+{
+  QItemSelection selection = ui.messageList->selectionModel()->selection();
+  if (selection.isEmpty()) {
+    QMessageBox::information(this, tr("Save Selected Logs"),
+                             tr("No messages are selected."));
+    return;
+  }
+
+  QString filename = promptForExportFile();
+  if (!filename.isEmpty()) {
+    exporter_.exportLogs(db_proxy_->exportJob(filename, selection));
+  }
+}
+
+void ConsoleWindow::saveTimeRange()
+{
+  // Times are entered in seconds since the first message, like the
+  // relative timestamps in the display.  The range starts out covering
+  // the selected messages, or everything if nothing is selected.  Rows
+  // aren't necessarily in stamp order, so every row is looked at.
+  QModelIndexList selected = ui.messageList->selectionModel()->selectedRows();
+  const int row_count = selected.isEmpty() ? db_proxy_->rowCount(QModelIndex()) : selected.size();
+
+  ros::Time min_stamp;
+  ros::Time max_stamp;
+  for (int i = 0; i < row_count; i++) {
+    const int row = selected.isEmpty() ? i : selected[i].row();
+    const ros::Time stamp = db_proxy_->rowStamp(row);
+    if (i == 0 || stamp < min_stamp) {
+      min_stamp = stamp;
+    }
+    if (i == 0 || stamp > max_stamp) {
+      max_stamp = stamp;
+    }
+  }
+
+  // The spin boxes show milliseconds, so the range is widened to whole
+  // milliseconds to include the first and last messages.
+  double begin = 0.0;
+  double end = 0.0;
+  if (row_count > 0) {
+    begin = std::max(0.0, (min_stamp - db_->minTime()).toSec());
+    end = std::max(begin, (max_stamp - db_->minTime()).toSec());
+    begin = std::floor(begin * 1000.0) / 1000.0;
+    end = std::floor(end * 1000.0 + 1.0) / 1000.0;
+  }
+
+  QDialog dialog(this);
+  dialog.setWindowTitle(tr("Save Time Range"));
+  QFormLayout *layout = new QFormLayout(&dialog);
+
+  QDoubleSpinBox *begin_box = new QDoubleSpinBox(&dialog);
+  begin_box->setDecimals(3);
+  begin_box->setRange(0.0, 1.0e9);
+  begin_box->setSuffix(tr(" s"));
+  begin_box->setValue(begin);
+  layout->addRow(tr("From:"), begin_box);
+
+  QDoubleSpinBox *end_box = new QDoubleSpinBox(&dialog);
+  end_box->setDecimals(3);
+  end_box->setRange(0.0, 1.0e9);
+  end_box->setSuffix(tr(" s"));
+  end_box->setValue(end);
+  layout->addRow(tr("To:"), end_box);
+
+  QDialogButtonBox *buttons = new QDialogButtonBox(
+    QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+  QObject::connect(buttons, SIGNAL(accepted()), &dialog, SLOT(accept()));
+  QObject::connect(buttons, SIGNAL(rejected()), &dialog, SLOT(reject()));
+  layout->addRow(buttons);
+
+  if (dialog.exec() != QDialog::Accepted) {
+    return;
+  }
+
+  QString filename = promptForExportFile();
+  if (!filename.isEmpty()) {
+    exporter_.exportLogs(db_proxy_->exportJob(
+                           filename,
+                           db_->minTime() + ros::Duration(begin_box->value()),
+                           db_->minTime() + ros::Duration(end_box->value())));
   }
 }
 
@@ -240,23 +429,38 @@ void ConsoleWindow::nodeSelectionChanged()
   db_proxy_->clearSearchFailure();  // clear search failure criteria, VCM 26 April 2017
   QModelIndexList selection = ui.nodeList->selectionModel()->selectedIndexes();
   std::set<std::string> nodes;
+  std::set<std::string> namespaces;
   QStringList node_names;
 
   for (int i = 0; i < selection.size(); i++) {
-    std::string name = node_list_model_->nodeName(selection[i]);
-    nodes.insert(name);
-    node_names.append(name.c_str());
+    node_tree_model_->addToFilter(selection[i], &nodes, &namespaces);
+    node_names.append(node_tree_model_->shortName(selection[i]));
   }
 
-  db_proxy_->setNodeFilter(nodes);
-
-  for (int i = 0; i < node_names.size(); i++) {
-    node_names[i] = node_names[i].split("/", QString::SkipEmptyParts).last();
-  }
+  db_proxy_->setNodeFilter(nodes, namespaces);
+  import_filter_.names = nodes;
+  import_filter_.prefixes = namespaces;
     
   setWindowTitle(QString("SWRI Console (") + node_names.join(", ") + ")");
 }
 
+void ConsoleWindow::templateSelectionChanged()
+{
+  db_proxy_->clearSearchFailure();
+  QModelIndexList selection = template_list_->selectionModel()->selectedIndexes();
+  std::set<uint32_t> template_ids;
+  for (int i = 0; i < selection.size(); i++) {
+    template_ids.insert(template_list_model_->templateId(selection[i]));
+  }
+
+  db_proxy_->setTemplateFilter(template_ids);
+}
+
+void ConsoleWindow::promptFilteredBagImport()
+{
+  Q_EMIT readFilteredBagFile(import_filter_);
+}
+
 void ConsoleWindow::setSeverityFilter()
 {
   uint8_t mask = 0;
@@ -285,6 +489,7 @@ void ConsoleWindow::setSeverityFilter()
   settings.setValue(SettingsKeys::SHOW_FATAL, ui.checkFatal->isChecked());
 
   db_proxy_->setSeverityFilter(mask);
+  import_filter_.severity_mask = mask;
   db_proxy_->clearSearchFailure();  // resets search failure variables, VCM 27 April 2017
 }
 
@@ -293,6 +498,26 @@ void ConsoleWindow::messagesAdded()
   if (ui.checkFollowNewest->isChecked()) {
     ui.messageList->scrollToBottom();
   }
+  updateMemoryUsage();
+}
+
+void ConsoleWindow::updateMemoryUsage()
+{
+  if (db_->memoryBudget() == 0) {
+    memory_usage_label_->hide();
+    return;
+  }
+
+  const MemoryUsage usage = db_->memoryUsage();
+  const double megabyte = 1024.0 * 1024.0;
+  memory_usage_label_->setText(
+    tr("Text: %1 MB in memory, %2 MB cached, %3 MB compressed, %4 MB on disk, %5 dropped")
+    .arg(usage.resident_bytes / megabyte, 0, 'f', 1)
+    .arg(usage.cached_bytes / megabyte, 0, 'f', 1)
+    .arg(usage.compressed_bytes / megabyte, 0, 'f', 1)
+    .arg(usage.spilled_bytes / megabyte, 0, 'f', 1)
+    .arg(usage.dropped_entries));
+  memory_usage_label_->show();
 }
 
 
@@ -600,6 +825,130 @@ void ConsoleWindow::toggleAlternateRowColors(bool checked)
   settings.setValue(SettingsKeys::ALTERNATE_LOG_ROW_COLORS, checked);
 }
 
+void ConsoleWindow::setCollapseRepeats(bool collapse)
+{
+  // Repeats are collapsed as messages are added to the database, so
+  // this only affects messages received from now on.
+  db_->setCollapseRepeats(collapse);
+
+  QSettings settings;
+  settings.setValue(SettingsKeys::COLLAPSE_REPEATS, collapse);
+}
+
+void ConsoleWindow::setJournalSession(bool journal)
+{
+  QSettings settings;
+  settings.setValue(SettingsKeys::JOURNAL_SESSION, journal);
+  Q_EMIT journalSessionChanged(journal);
+}
+
+void ConsoleWindow::setSubscribeRosout(bool subscribe)
+{
+  if (!subscribe) {
+    path_statistics_label_->hide();
+  }
+
+  QSettings settings;
+  settings.setValue(SettingsKeys::SUBSCRIBE_ROSOUT, subscribe);
+  Q_EMIT subscribeRosoutChanged(subscribe);
+}
+
+void ConsoleWindow::showPathStatistics(const RosoutPathStatistics &statistics)
+{
+  if (!ui.action_SubscribeRosout->isChecked()) {
+    return;
+  }
+
+  path_statistics_label_->setText(
+    tr("Lost: %1 on /rosout, %2 on /rosout_agg")
+    .arg(statistics.lost[ROSOUT_DIRECT])
+    .arg(statistics.lost[ROSOUT_AGGREGATED]));
+  path_statistics_label_->setToolTip(
+    tr("/rosout: %1 received, %2 first, %3 lost\n"
+       "/rosout_agg: %4 received, %5 first, %6 lost")
+    .arg(statistics.received[ROSOUT_DIRECT])
+    .arg(statistics.first[ROSOUT_DIRECT])
+    .arg(statistics.lost[ROSOUT_DIRECT])
+    .arg(statistics.received[ROSOUT_AGGREGATED])
+    .arg(statistics.first[ROSOUT_AGGREGATED])
+    .arg(statistics.lost[ROSOUT_AGGREGATED]));
+  path_statistics_label_->show();
+}
+
+void ConsoleWindow::selectBodyCacheSize()
+{
+  QSettings settings;
+  int megabytes = settings.value(SettingsKeys::BODY_CACHE_SIZE, 256).toInt();
+
+  bool ok = false;
+  megabytes = QInputDialog::getInt(this,
+                                   tr("Message Cache Size"),
+                                   tr("Memory used for the text of browsed bag files (MB):"),
+                                   megabytes, 16, 65536, 16, &ok);
+  if (!ok) {
+    return;
+  }
+
+  db_->setBodyCacheSize(megabytes);
+  settings.setValue(SettingsKeys::BODY_CACHE_SIZE, megabytes);
+}
+
+void ConsoleWindow::selectRateLimit()
+{
+  bool ok = false;
+  int rate = QInputDialog::getInt(this,
+                                  tr("Rate Limit"),
+                                  tr("Debug and info messages per second and node (0 for no limit):"),
+                                  db_->rateLimit(), 0, 1000000, 100, &ok);
+  if (!ok) {
+    return;
+  }
+
+  db_->setRateLimit(rate);
+  QSettings settings;
+  settings.setValue(SettingsKeys::RATE_LIMIT, rate);
+}
+
+void ConsoleWindow::selectMemoryBudget()
+{
+  QSettings settings;
+
+  QDialog dialog(this);
+  dialog.setWindowTitle(tr("Memory Budget"));
+  QFormLayout *layout = new QFormLayout(&dialog);
+
+  QSpinBox *memory_box = new QSpinBox(&dialog);
+  memory_box->setRange(0, 1024 * 1024);
+  memory_box->setSingleStep(256);
+  memory_box->setSuffix(tr(" MB"));
+  memory_box->setSpecialValueText(tr("No limit"));
+  memory_box->setValue(settings.value(SettingsKeys::MEMORY_BUDGET, 0).toInt());
+  layout->addRow(tr("Message text in memory:"), memory_box);
+
+  QSpinBox *spill_box = new QSpinBox(&dialog);
+  spill_box->setRange(0, 1024 * 1024);
+  spill_box->setSingleStep(256);
+  spill_box->setSuffix(tr(" MB"));
+  spill_box->setSpecialValueText(tr("Don't spill"));
+  spill_box->setValue(settings.value(SettingsKeys::SPILL_BUDGET, 4096).toInt());
+  layout->addRow(tr("Spilled to disk:"), spill_box);
+
+  QDialogButtonBox *buttons = new QDialogButtonBox(
+    QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+  QObject::connect(buttons, SIGNAL(accepted()), &dialog, SLOT(accept()));
+  QObject::connect(buttons, SIGNAL(rejected()), &dialog, SLOT(reject()));
+  layout->addRow(buttons);
+
+  if (dialog.exec() != QDialog::Accepted) {
+    return;
+  }
+
+  db_->setMemoryBudget(memory_box->value(), spill_box->value());
+  settings.setValue(SettingsKeys::MEMORY_BUDGET, memory_box->value());
+  settings.setValue(SettingsKeys::SPILL_BUDGET, spill_box->value());
+  updateMemoryUsage();
+}
+
 void ConsoleWindow::loadSettings()
 {
   // First, load all the boolean settings...
@@ -607,6 +956,9 @@ void ConsoleWindow::loadSettings()
   loadBooleanSetting(SettingsKeys::ABSOLUTE_TIMESTAMPS, ui.action_AbsoluteTimestamps);
   loadBooleanSetting(SettingsKeys::USE_REGEXPS, ui.action_RegularExpressions);
   loadBooleanSetting(SettingsKeys::COLORIZE_LOGS, ui.action_ColorizeLogs);
+  loadBooleanSetting(SettingsKeys::COLLAPSE_REPEATS, ui.action_CollapseRepeats);
+  loadBooleanSetting(SettingsKeys::JOURNAL_SESSION, ui.action_JournalSession);
+  loadBooleanSetting(SettingsKeys::SUBSCRIBE_ROSOUT, ui.action_SubscribeRosout);
   loadBooleanSetting(SettingsKeys::FOLLOW_NEWEST, ui.checkFollowNewest);
 
   // The severity level has to be handled a little differently, since they're all combined
@@ -625,6 +977,11 @@ void ConsoleWindow::loadSettings()
   ui.checkFatal->setChecked(showFatal);
   setSeverityFilter();
 
+  db_->setBodyCacheSize(settings.value(SettingsKeys::BODY_CACHE_SIZE, 256).toInt());
+  db_->setRateLimit(settings.value(SettingsKeys::RATE_LIMIT, 0).toInt());
+  db_->setMemoryBudget(settings.value(SettingsKeys::MEMORY_BUDGET, 0).toInt(),
+                       settings.value(SettingsKeys::SPILL_BUDGET, 4096).toInt());
+
   // Load button colors.
   loadColorButtonSetting(SettingsKeys::DEBUG_COLOR, ui.debugColorWidget);
   loadColorButtonSetting(SettingsKeys::INFO_COLOR, ui.infoColorWidget);
@@ -28,14 +28,141 @@
 //
 // *****************************************************************************
 
+#include <algorithm>
+
 #include <swri_console/log_database.h>
+#include <swri_console/background_delete.h>
 
 namespace swri_console
 {
+static const size_t NO_ENTRY = static_cast<size_t>(-1);
+
+// Body source text is fetched in pages of this many messages.
+static const size_t BODY_PAGE_BITS = 8;
+static const size_t BODY_PAGE_SIZE = 1 << BODY_PAGE_BITS;
+static const size_t BODY_PAGE_MASK = BODY_PAGE_SIZE - 1;
+static const int DEFAULT_BODY_CACHE_MB = 256;
+// The most chunks degraded each time the queue is processed, so that
+// lowering the budget doesn't freeze the GUI.
+static const int MAX_DEGRADED_CHUNKS = 4;
+
+// Rough size of a message's text in memory.
+static size_t textBytes(const QStringList &text)
+{
+  size_t bytes = 0;
+  for (int i = 0; i < text.size(); i++) {
+    bytes += 32 + text[i].size() * sizeof(QChar);
+  }
+  return bytes;
+}
+
+static bool isHexDigit(char c)
+{
+  return ((c >= '0' && c <= '9') ||
+          (c >= 'a' && c <= 'f') ||
+          (c >= 'A' && c <= 'F'));
+}
+
+static bool isPathStart(const std::string &text, size_t i)
+{
+  if (i > 0 && text[i-1] != ' ' && text[i-1] != '\'' && text[i-1] != '"' &&
+      text[i-1] != '=' && text[i-1] != ':' && text[i-1] != '(' &&
+      text[i-1] != '[' && text[i-1] != '\t') {
+    return false;
+  }
+
+  if (text[i] == '/') {
+    return true;
+  }
+  if (text.compare(i, 2, "~/") == 0 || text.compare(i, 2, "./") == 0) {
+    return true;
+  }
+  return text.compare(i, 3, "../") == 0;
+}
+
+// Reduce a message to its template by masking out the parts that
+// typically vary between messages generated by the same format
+// string.  Numbers (including decimals and hex values with a "0x"
+// prefix) are replaced by '#', and tokens that look like file system paths (start with a
+// '/', './', '../' or '~/' and contain at least two separators) are
+// replaced by "<path>".
+QByteArray templateFingerprint(const std::string &text)
+{
+  QByteArray fingerprint;
+  fingerprint.reserve(text.size());
+
+  size_t i = 0;
+  while (i < text.size()) {
+    const char c = text[i];
+
+    if (c >= '0' && c <= '9') {
+      // Hex digits are only swallowed after an explicit "0x", so that
+      // units like "30fps" or "3dB" keep their letters.
+      size_t j = i + 1;
+      if (c == '0' && j + 1 < text.size() && (text[j] == 'x' || text[j] == 'X') &&
+          isHexDigit(text[j + 1])) {
+        j++;
+        while (j < text.size() && isHexDigit(text[j])) {
+          j++;
+        }
+      } else {
+        while (j < text.size() && ((text[j] >= '0' && text[j] <= '9') || text[j] == '.')) {
+          j++;
+        }
+      }
+      fingerprint.append('#');
+      i = j;
+      continue;
+    }
+
+    if (isPathStart(text, i)) {
+      size_t j = i;
+      int separators = 0;
+      while (j < text.size() &&
+             text[j] != ' ' && text[j] != '\t' && text[j] != '\n' &&
+             text[j] != '\'' && text[j] != '"' && text[j] != ',' &&
+             text[j] != ')' && text[j] != ']') {
+        if (text[j] == '/') {
+          separators++;
+        }
+        j++;
+      }
+
+      if (separators >= 2) {
+        fingerprint.append("<path>");
+      } else {
+        fingerprint.append(text.data() + i, j - i);
+      }
+      i = j;
+      continue;
+    }
+
+    fingerprint.append(c);
+    i++;
+  }
+
+  return fingerprint;
+}
+
 LogDatabase::LogDatabase()
   :
+  body_cache_mb_(DEFAULT_BODY_CACHE_MB),
+  store_(new LogStore(), deleteInBackground<LogStore>),
+  collapse_repeats_(false),
+  entries_updated_(false),
+  rate_limit_(0),
+  memory_budget_(0),
+  disk_budget_(0),
+  resident_bytes_(0),
+  compressed_chunks_(0),
+  spilled_chunks_(0),
+  dropped_chunks_(0),
   min_time_(ros::TIME_MAX)
 {
+  clock_.start();
+  body_sources_.push_back(QSharedPointer<LogBodySource>());
+  setBodyCacheSize(DEFAULT_BODY_CACHE_MB);
+  addSource("local");
 }
 
 LogDatabase::~LogDatabase()
@@ -44,43 +171,563 @@ LogDatabase::~LogDatabase()
 
 void LogDatabase::clear()
 {
-  std::map<std::string, size_t>::iterator iter;
-  msg_counts_.clear();
-  log_.clear();
+  // Node ids remain valid, only their counts are reset.
+  std::fill(msg_counts_.begin(), msg_counts_.end(), MessageCounts());
+  // Destroying millions of entries can freeze the GUI for seconds, so
+  // the old store is freed in the background once the last snapshot
+  // referring to it is gone.  Queued messages refer to templates and
+  // indices that are about to be invalidated, so they are dropped
+  // along with it.
+  store_ = QSharedPointer<LogStore>(new LogStore(), deleteInBackground<LogStore>);
+  std::fill(batch_counts_.begin(), batch_counts_.end(), MessageCounts());
+  batch_nodes_.clear();
+  count_deltas_.clear();
+  std::fill(last_entry_.begin(), last_entry_.end(), NO_ENTRY);
+  clearInBackground(templates_);
+  template_ids_.clear();
+  body_sources_.resize(1);
+  body_cache_.clear();
+  for (size_t i = 0; i < dropping_nodes_.size(); i++) {
+    governors_[dropping_nodes_[i]].dropped.clear();
+  }
+  dropping_nodes_.clear();
+  chunk_text_bytes_.clear();
+  resident_bytes_ = 0;
+  compressed_chunks_ = 0;
+  spilled_chunks_ = 0;
+  dropped_chunks_ = 0;
+  tiered_source_.clear();
   Q_EMIT databaseCleared();
 }
 
-void LogDatabase::queueMessage(const rosgraph_msgs::LogConstPtr msg)
+void LogDatabase::setCollapseRepeats(bool collapse)
 {
-  if (msg->header.stamp < min_time_) {
-    min_time_ = msg->header.stamp;
+  collapse_repeats_ = collapse;
+  // Runs are only tracked while collapsing is enabled, so forget
+  // about them when it's turned off.  Otherwise a message received
+  // after re-enabling could be folded into a stale entry.
+  std::fill(last_entry_.begin(), last_entry_.end(), NO_ENTRY);
+}
+
+int LogDatabase::addSource(const std::string &name)
+{
+  source_names_.push_back(name);
+  node_ids_.push_back(boost::unordered_map<std::string, uint32_t>());
+  return source_names_.size() - 1;
+}
+
+std::string sourceNodeName(const std::string &source_name, const std::string &node_name)
+{
+  if (!node_name.empty() && node_name[0] == '/') {
+    return "/" + source_name + node_name;
+  }
+  return "/" + source_name + "/" + node_name;
+}
+
+uint32_t LogDatabase::nodeId(const std::string &name, int source_id)
+{
+  boost::unordered_map<std::string, uint32_t> &ids = node_ids_[source_id];
+  boost::unordered_map<std::string, uint32_t>::const_iterator it = ids.find(name);
+  if (it != ids.end()) {
+    return it->second;
+  }
+
+  uint32_t id = node_names_.size();
+  ids[name] = id;
+  if (source_id == 0) {
+    node_names_.push_back(name);
+  } else {
+    node_names_.push_back(sourceNodeName(source_names_[source_id], name));
+  }
+  node_sources_.push_back(source_id);
+  RateGovernor governor;
+  governor.tokens = rate_limit_;
+  governor.refill_time = clock_.elapsed();
+  governor.summary_time = 0;
+  governors_.push_back(governor);
+  msg_counts_.push_back(MessageCounts());
+  batch_counts_.push_back(MessageCounts());
+  last_entry_.push_back(NO_ENTRY);
+  return id;
+}
+
+void LogDatabase::countMessage(uint32_t node_id, const ros::Time &stamp, uint8_t level,
+                               size_t count)
+{
+  if (stamp < min_time_) {
+    min_time_ = stamp;
     Q_EMIT minTimeUpdated();
   }
-  
-  msg_counts_[msg->name]++;
+
+  msg_counts_[node_id].add(level, count);
+  if (batch_counts_[node_id].total == 0) {
+    batch_nodes_.push_back(node_id);
+  }
+  batch_counts_[node_id].add(level, count);
+}
+
+template <class Message>
+void LogDatabase::addMessage(const Message &msg, int source_id, bool live)
+{
+  uint32_t node_id = nodeId(msg.name, source_id);
+  countMessage(node_id, msg.header.stamp, msg.level);
+  // This comes before anything else, since the point is to shed the
+  // cost of storing the message.
+  if (live && !admitMessage(node_id, msg.level, msg.header.stamp)) {
+    return;
+  }
+
+  const uint32_t file_id = files_.intern(msg.file);
+  QStringList text = QString::fromUtf8(msg.msg.data(), msg.msg.size()).split('\n');
+  if (collapse_repeats_ &&
+      collapseRepeat(node_id, msg.level, msg.line, file_id, text, msg.header.stamp)) {
+    return;
+  }
 
   LogEntry log;
-  log.stamp = msg->header.stamp;
-  log.level = msg->level;
-  log.node = msg->name;
-  log.file = msg->file;
-  log.function = msg->function;
-  log.line = msg->line;
-  log.text = QString(msg->msg.c_str()).split('\n');
-  log.seq = msg->header.seq;
-  new_msgs_.push_back(log);
+  log.stamp = msg.header.stamp;
+  log.level = msg.level;
+  log.node_id = node_id;
+  log.file_id = file_id;
+  log.function_id = functions_.intern(msg.function);
+  log.line = msg.line;
+  log.seq = msg.header.seq;
+  log.text = text;
+  log.line_count = text.size();
+  log.body_source = 0;
+  log.body_locator = 0;
+  log.repeat_count = 1;
+  log.last_stamp = msg.header.stamp;
+  const size_t index = store_->appendedSize();
+  if (!store_->append(log)) {
+    qWarning("Log database is full; dropping message from %s.", node_names_[node_id].c_str());
+    return;
+  }
+  store_->entry(index).template_id = addToTemplate(templateFingerprint(msg.msg), index);
+  addResidentText(index, text);
+
+  if (collapse_repeats_) {
+    last_entry_[node_id] = store_->appendedSize() - 1;
+  }
+}
+
+void LogDatabase::queueMessages(const MessageList &msgs)
+{
+  for (size_t i = 0; i < msgs.size(); i++) {
+    addMessage(*msgs[i], 0, false);
+  }
+}
+
+void LogDatabase::queueLiveMessages(const MessageList &msgs)
+{
+  for (size_t i = 0; i < msgs.size(); i++) {
+    addMessage(*msgs[i], 0, true);
+  }
+}
+
+void LogDatabase::queueRosoutMessages(const RosoutMessageList &msgs)
+{
+  queueSourceMessages(0, msgs);
+}
+
+void LogDatabase::queueSourceMessages(int source_id, const RosoutMessageList &msgs)
+{
+  for (size_t i = 0; i < msgs.size(); i++) {
+    addMessage(*msgs[i], source_id, true);
+  }
+}
+
+uint32_t LogDatabase::bodySourceId(const QSharedPointer<LogBodySource> &source)
+{
+  // There are only ever a handful of sources.
+  for (size_t i = 1; i < body_sources_.size(); i++) {
+    if (body_sources_[i] == source) {
+      return i;
+    }
+  }
+  body_sources_.push_back(source);
+  return body_sources_.size() - 1;
+}
+
+// Indexed messages are never collapsed, since their text isn't
+// available to compare against.
+void LogDatabase::queueIndexedMessages(const IndexedMessageBatch &batch)
+{
+  const uint32_t source_id = bodySourceId(batch.source);
+
+  for (size_t i = 0; i < batch.msgs.size(); i++) {
+    const IndexedMessage &msg = batch.msgs[i];
+    uint32_t node_id = nodeId(msg.node, 0);
+    const uint32_t repeat_count = std::max<uint32_t>(1, msg.repeat_count);
+    countMessage(node_id, msg.stamp, msg.level, repeat_count);
+
+    LogEntry log;
+    log.stamp = msg.stamp;
+    log.level = msg.level;
+    log.node_id = node_id;
+    log.file_id = files_.intern(msg.file);
+    log.function_id = functions_.intern(msg.function);
+    log.line = msg.line;
+    log.seq = msg.seq;
+    log.line_count = msg.line_count;
+    log.body_source = source_id;
+    log.body_locator = msg.body_locator;
+    log.repeat_count = repeat_count;
+    log.last_stamp = msg.last_stamp;
+    const size_t index = store_->appendedSize();
+    if (!store_->append(log)) {
+      qWarning("Log database is full; dropping message from %s.", msg.node.c_str());
+      return;
+    }
+    const uint32_t template_id = addToTemplate(msg.template_key, index);
+    store_->entry(index).template_id = template_id;
+    templates_[template_id].count += repeat_count - 1;
+  }
+}
+
+QStringList LogDatabase::text(const LogEntry &entry) const
+{
+  if (!entry.text.isEmpty() || entry.body_source >= body_sources_.size()) {
+    return entry.text;
+  }
+
+  const uint64_t page = entry.body_locator >> BODY_PAGE_BITS;
+  const size_t offset = entry.body_locator & BODY_PAGE_MASK;
+  const quint64 key = (static_cast<quint64>(entry.body_source) << 48) | page;
+
+  QStringList text;
+  BodyPage *cached = body_cache_.object(key);
+  if (cached) {
+    if (offset < cached->size()) {
+      text = (*cached)[offset];
+    }
+  } else {
+    BodyPage *texts = new BodyPage();
+    body_sources_[entry.body_source]->textRange(page << BODY_PAGE_BITS, BODY_PAGE_SIZE, texts);
+    if (offset < texts->size()) {
+      text = (*texts)[offset];
+    }
+
+    // Rough size of the page in kB.
+    size_t bytes = 0;
+    for (size_t i = 0; i < texts->size(); i++) {
+      bytes += textBytes((*texts)[i]);
+    }
+    // QCache takes ownership, and deletes the page right away if it
+    // is over budget by itself.
+    body_cache_.insert(key, texts, 1 + bytes / 1024);
+  }
+
+  // Keep the line mapping consistent even if the source is unreadable.
+  while (text.size() < static_cast<int>(entry.line_count)) {
+    text.append(QString());
+  }
+  return text;
+}
+
+void LogDatabase::setBodyCacheSize(int megabytes)
+{
+  body_cache_mb_ = std::max(1, megabytes);
+  updateBodyCacheCost();
+}
+
+void LogDatabase::updateBodyCacheCost()
+{
+  // The cache's cost is in kB.
+  size_t max_cost = static_cast<size_t>(body_cache_mb_) * 1024;
+  if (memory_budget_ > 0) {
+    max_cost = std::min(max_cost, std::max<size_t>(1, (memory_budget_ / 4) >> 10));
+  }
+  body_cache_.setMaxCost(static_cast<int>(max_cost));
+}
+
+void LogDatabase::setMemoryBudget(int memory_megabytes, int disk_megabytes)
+{
+  memory_budget_ = static_cast<size_t>(std::max(0, memory_megabytes)) << 20;
+  disk_budget_ = static_cast<size_t>(std::max(0, disk_megabytes)) << 20;
+  updateBodyCacheCost();
+  enforceMemoryBudget();
+}
+
+MemoryUsage LogDatabase::memoryUsage() const
+{
+  MemoryUsage usage;
+  usage.resident_bytes = resident_bytes_;
+  usage.cached_bytes = static_cast<size_t>(body_cache_.totalCost()) << 10;
+  usage.compressed_bytes = tiered_source_ ? tiered_source_->compressedBytes() : 0;
+  usage.spilled_bytes = tiered_source_ ? tiered_source_->spilledBytes() : 0;
+  usage.dropped_entries = tiered_source_ ? tiered_source_->droppedEntries() : 0;
+  return usage;
+}
+
+void LogDatabase::addResidentText(size_t index, const QStringList &text)
+{
+  const size_t chunk = index / LogStore::chunkSize();
+  if (chunk >= chunk_text_bytes_.size()) {
+    chunk_text_bytes_.resize(chunk + 1, 0);
+  }
+  const size_t bytes = textBytes(text);
+  chunk_text_bytes_[chunk] += bytes;
+  resident_bytes_ += bytes;
+}
+
+// Degrades the oldest chunks until the text fits in the budget.  The
+// text of committed entries can only be moved while no other thread
+// is reading them, so nothing is done while there are snapshots; the
+// budget is enforced again the next time the queue is processed.
+void LogDatabase::enforceMemoryBudget()
+{
+  if (memory_budget_ == 0 || store_->snapshotCount() > 0) {
+    return;
+  }
+
+  // Only full chunks are degraded, since the last one is still being
+  // appended to.
+  const size_t full_chunks = store_->size() / LogStore::chunkSize();
+  for (int i = 0; i < MAX_DEGRADED_CHUNKS; i++) {
+    const MemoryUsage usage = memoryUsage();
+    if (usage.resident_bytes + usage.cached_bytes + usage.compressed_bytes <= memory_budget_) {
+      break;
+    }
+
+    if (compressed_chunks_ < full_chunks) {
+      compressChunk(compressed_chunks_);
+      compressed_chunks_++;
+    } else if (spilled_chunks_ < compressed_chunks_) {
+      // Chunks that can't be spilled, e.g. because the disk is full,
+      // are dropped right away.
+      if (disk_budget_ == 0 || !tiered_source_->spill(spilled_chunks_)) {
+        tiered_source_->drop(spilled_chunks_);
+      }
+      spilled_chunks_++;
+    } else {
+      break;
+    }
+  }
+
+  while (tiered_source_ && tiered_source_->spilledBytes() > disk_budget_ &&
+         dropped_chunks_ < spilled_chunks_) {
+    tiered_source_->drop(dropped_chunks_);
+    dropped_chunks_++;
+  }
+}
+
+// Moves the text of a chunk's entries into the tiered body source.
+// Entries whose text is already held by another body source are left
+// alone.
+void LogDatabase::compressChunk(size_t chunk)
+{
+  if (!tiered_source_) {
+    tiered_source_ = QSharedPointer<TieredBodySource>(new TieredBodySource());
+  }
+  const uint32_t source_id = bodySourceId(tiered_source_);
+
+  const size_t first = chunk * LogStore::chunkSize();
+  std::vector<QStringList> texts(LogStore::chunkSize());
+  for (size_t i = 0; i < texts.size(); i++) {
+    const LogEntry &entry = store_->entry(first + i);
+    if (entry.body_source == 0) {
+      texts[i] = entry.text;
+    }
+  }
+  tiered_source_->compress(chunk, texts);
+
+  for (size_t i = 0; i < texts.size(); i++) {
+    LogEntry &entry = store_->entry(first + i);
+    if (entry.body_source == 0) {
+      entry.text = QStringList();
+      entry.body_source = source_id;
+      entry.body_locator = first + i;
+    }
+  }
+
+  if (chunk < chunk_text_bytes_.size()) {
+    resident_bytes_ -= chunk_text_bytes_[chunk];
+    chunk_text_bytes_[chunk] = 0;
+  }
+}
+
+// If a message is identical to the last entry received from the same node,
+// fold it into that entry and return true.
+bool LogDatabase::collapseRepeat(uint32_t node_id,
+                                 uint8_t level,
+                                 uint32_t line,
+                                 uint32_t file_id,
+                                 const QStringList &text,
+                                 const ros::Time &stamp)
+{
+  const size_t last_index = last_entry_[node_id];
+  if (last_index == NO_ENTRY) {
+    return false;
+  }
+
+  LogEntry &last = store_->entry(last_index);
+  if (last.level != level ||
+      last.line != line ||
+      last.file_id != file_id ||
+      last.text != text) {
+    return false;
+  }
+
+  last.repeat_count++;
+  last.last_stamp = stamp;
+  templates_[last.template_id].count++;
+  if (last_index < store_->size()) {
+    entries_updated_ = true;
+  }
+  return true;
+}
+
+// Add the entry at index to the template with the given fingerprint,
+// creating a new template if necessary, and return the template's id.
+uint32_t LogDatabase::addToTemplate(const QByteArray &fingerprint, size_t index)
+{
+  uint32_t id;
+  QHash<QByteArray, uint32_t>::const_iterator it = template_ids_.constFind(fingerprint);
+  if (it == template_ids_.constEnd()) {
+    id = templates_.size();
+    template_ids_.insert(fingerprint, id);
+
+    LogTemplate log_template;
+    log_template.pattern = QString::fromUtf8(fingerprint.constData(),
+                                             fingerprint.size());
+    log_template.count = 0;
+    templates_.push_back(log_template);
+  } else {
+    id = it.value();
+  }
+
+  templates_[id].count++;
+  templates_[id].members.push_back(index);
+  return id;
+}
+
+void LogDatabase::setRateLimit(int messages_per_second)
+{
+  addDropSummaries(true);
+  rate_limit_ = std::max(0, messages_per_second);
+  const qint64 now = clock_.elapsed();
+  for (size_t i = 0; i < governors_.size(); i++) {
+    governors_[i].tokens = rate_limit_;
+    governors_[i].refill_time = now;
+  }
+}
+
+// Returns false if a message should be dropped to stay within the
+// node's rate limit.
+bool LogDatabase::admitMessage(uint32_t node_id, uint8_t level, const ros::Time &stamp)
+{
+  if (rate_limit_ == 0 || level >= rosgraph_msgs::Log::WARN) {
+    return true;
+  }
+
+  // The bucket holds up to a second's worth of tokens, so short bursts
+  // aren't sampled.
+  RateGovernor &governor = governors_[node_id];
+  const qint64 now = clock_.elapsed();
+  governor.tokens = std::min<double>(
+    rate_limit_,
+    governor.tokens + (now - governor.refill_time) * rate_limit_ / 1000.0);
+  governor.refill_time = now;
+  if (governor.tokens >= 1.0) {
+    governor.tokens -= 1.0;
+    return true;
+  }
+
+  if (governor.dropped.total == 0) {
+    dropping_nodes_.push_back(node_id);
+    governor.first_dropped = stamp;
+    governor.summary_time = now;
+  }
+  governor.dropped.add(level);
+  governor.last_dropped = stamp;
+  return false;
+}
+
+// Adds an entry summing up the messages each node dropped, once a
+// second has passed since its first dropped message, or right away if
+// flush_all is set.
+void LogDatabase::addDropSummaries(bool flush_all)
+{
+  const qint64 now = clock_.elapsed();
+  std::vector<uint32_t> still_dropping;
+  for (size_t i = 0; i < dropping_nodes_.size(); i++) {
+    const uint32_t node_id = dropping_nodes_[i];
+    RateGovernor &governor = governors_[node_id];
+    if (!flush_all && now - governor.summary_time < 1000) {
+      still_dropping.push_back(node_id);
+      continue;
+    }
+
+    const MessageCounts &dropped = governor.dropped;
+    const QString text = QString(
+      "Rate limit of %1 messages/s exceeded; dropped %2 messages "
+      "(%3 debug, %4 info) over %5 s.")
+      .arg(rate_limit_)
+      .arg(dropped.total)
+      .arg(dropped.severity[severityIndex(rosgraph_msgs::Log::DEBUG)])
+      .arg(dropped.severity[severityIndex(rosgraph_msgs::Log::INFO)])
+      .arg((governor.last_dropped - governor.first_dropped).toSec(), 0, 'f', 1);
+
+    // The summary gets the highest severity that was dropped, so that
+    // it shows up along with the messages it stands for.
+    LogEntry log;
+    log.stamp = governor.last_dropped;
+    log.level = dropped.severity[severityIndex(rosgraph_msgs::Log::INFO)] > 0 ?
+      rosgraph_msgs::Log::INFO : rosgraph_msgs::Log::DEBUG;
+    log.node_id = node_id;
+    log.file_id = files_.intern("");
+    log.function_id = functions_.intern("");
+    log.line = 0;
+    log.seq = 0;
+    log.text = QStringList(text);
+    log.line_count = 1;
+    log.body_source = 0;
+    log.body_locator = 0;
+    log.repeat_count = 1;
+    log.last_stamp = governor.last_dropped;
+    const size_t index = store_->appendedSize();
+    if (store_->append(log)) {
+      store_->entry(index).template_id =
+        addToTemplate(templateFingerprint(text.toStdString()), index);
+      addResidentText(index, log.text);
+      // Don't fold later messages into an entry from before the summary.
+      last_entry_[node_id] = NO_ENTRY;
+    }
+    governor.dropped.clear();
+  }
+  dropping_nodes_.swap(still_dropping);
 }
 
 void LogDatabase::processQueue()
 {
-  if (new_msgs_.empty()) {
+  if (!dropping_nodes_.empty()) {
+    addDropSummaries(false);
+  }
+
+  if (entries_updated_) {
+    entries_updated_ = false;
+    Q_EMIT messagesUpdated();
+  }
+
+  // Collapsed repeats change the node counts without adding any
+  // entries, so we check for both.
+  if (store_->appendedSize() == store_->size() && batch_nodes_.empty()) {
     return;
   }
   
-  log_.insert(log_.end(),
-              new_msgs_.begin(),
-              new_msgs_.end());
-  new_msgs_.clear();
+  store_->commit();
+  enforceMemoryBudget();
+
+  count_deltas_.clear();
+  for (size_t i = 0; i < batch_nodes_.size(); i++) {
+    NodeCountDelta delta;
+    delta.node_id = batch_nodes_[i];
+    delta.counts = batch_counts_[delta.node_id];
+    count_deltas_.push_back(delta);
+    batch_counts_[delta.node_id].clear();
+  }
+  batch_nodes_.clear();
 
   Q_EMIT messagesAdded();              
 }
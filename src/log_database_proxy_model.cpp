@@ -31,17 +31,16 @@
 #include <stdio.h>
 #include <algorithm>
 #include <iterator>
+#include <vector>
 
 #include <ros/time.h>
-#include <rosbag/bag.h>
 
 #include <swri_console/log_database_proxy_model.h>
 #include <swri_console/log_database.h>
+#include <swri_console/background_delete.h>
 #include <swri_console/settings_keys.h>
 
 #include <QColor>
-#include <QFile>
-#include <QTextStream>
 #include <QTimer>
 #include <QSettings>
 #include <QtGlobal>
@@ -67,6 +66,8 @@ LogDatabaseProxyModel::LogDatabaseProxyModel(LogDatabase *db)
                    this, SLOT(handleDatabaseCleared()));
   QObject::connect(db_, SIGNAL(messagesAdded()),
                    this, SLOT(processNewMessages()));
+  QObject::connect(db_, SIGNAL(messagesUpdated()),
+                   this, SLOT(handleMessagesUpdated()));
 
   QObject::connect(db_, SIGNAL(minTimeUpdated()),
                    this, SLOT(minTimeUpdated()));
@@ -76,9 +77,18 @@ LogDatabaseProxyModel::~LogDatabaseProxyModel()
 {
 }
 
-void LogDatabaseProxyModel::setNodeFilter(const std::set<std::string> &names)
+void LogDatabaseProxyModel::setNodeFilter(const std::set<std::string> &names,
+                                          const std::set<std::string> &prefixes)
 {
   names_ = names;
+  prefixes_ = prefixes;
+  node_filter_.clear();
+  reset();
+}
+
+void LogDatabaseProxyModel::setTemplateFilter(const std::set<uint32_t> &template_ids)
+{
+  template_ids_ = template_ids;
   reset();
 }
 
@@ -291,7 +301,7 @@ int LogDatabaseProxyModel::getItemIndex(const QString searchText, int index, int
   {
     const LineMap line_idx = msg_mapping_[index];
     const LogEntry &item = db_->log()[line_idx.log_index];
-    QString tempString = item.text.join("|");  // concatenate strings
+    QString tempString = db_->text(item).join("|");  // concatenate strings
     if(tempString.toUpper().contains(searchText))  // search match found
     {
       clearSearchFailure();  // reset failed search variables
@@ -355,46 +365,21 @@ QVariant LogDatabaseProxyModel::data(
   const LogEntry &item = db_->log()[line_idx.log_index];
 
   if (role == Qt::DisplayRole) {
-    char level = '?';
-    if (item.level == rosgraph_msgs::Log::DEBUG) {
-      level = 'D';
-    } else if (item.level == rosgraph_msgs::Log::INFO) {
-      level = 'I';
-    } else if (item.level == rosgraph_msgs::Log::WARN) {
-      level = 'W';
-    } else if (item.level == rosgraph_msgs::Log::ERROR) {
-      level = 'E';
-    } else if (item.level == rosgraph_msgs::Log::FATAL) {
-      level = 'F';
-    }
-
-    char stamp[128];
-    if (display_absolute_time_) {
-      snprintf(stamp, sizeof(stamp),
-               "%u.%09u",
-               item.stamp.sec,
-               item.stamp.nsec);
-    } else {
-      ros::Duration t = item.stamp - db_->minTime();
-
-      int32_t secs = t.sec;
-      int hours = secs / 60 / 60;
-      int minutes = (secs / 60) % 60;
-      int seconds = (secs % 60);
-      int milliseconds = t.nsec / 1000000;
-      
-      snprintf(stamp, sizeof(stamp),
-               "%d:%02d:%02d:%03d",
-               hours, minutes, seconds, milliseconds);
-    }
-
     char header[1024];
-    if (display_time_) {
-      snprintf(header, sizeof(header),
-               "[%c %s] ", level, stamp);
-    } else {
-      snprintf(header, sizeof(header),
-               "[%c] ", level);
+    formatLogHeader(header, sizeof(header),
+                    item.level, item.stamp, db_->minTime(),
+                    display_time_, display_absolute_time_);
+
+    // Once messages are coming from more than one ROS master, a column
+    // shows which one each message came from.
+    if (db_->sourceCount() > 1) {
+      int width = 0;
+      for (size_t i = 0; i < db_->sourceCount(); i++) {
+        width = std::max(width, static_cast<int>(db_->sourceName(i).size()));
+      }
+      size_t len = strnlen(header, sizeof(header));
+      snprintf(header + len, sizeof(header) - len, "%-*s ",
+               width, db_->sourceName(db_->nodeSource(item.node_id)).c_str());
     }
 
     // For multiline messages, we only want to display the header for
@@ -406,9 +391,14 @@ QVariant LogDatabaseProxyModel::data(
       for (size_t i = 0; i < len; i++) {
         header[i] = ' ';
       }
+    } else if (item.repeat_count > 1) {
+      // Collapsed entries are prefixed with their repeat count, e.g. "×12".
+      return QVariant(QString(header) +
+                      QChar(0x00D7) + QString::number(item.repeat_count) + " " +
+                      db_->text(item)[line_idx.line_index]);
     }
     
-    return QVariant(QString(header) + item.text[line_idx.line_index]);
+    return QVariant(QString(header) + db_->text(item)[line_idx.line_index]);
   }
   else if (role == Qt::ForegroundRole && colorize_logs_) {
     switch (item.level) {
@@ -440,13 +430,22 @@ QVariant LogDatabaseProxyModel::data(
              item.stamp.sec,
              item.stamp.nsec,
              item.seq,
-             item.node.c_str(),
-             item.function.c_str(),
-             item.file.c_str(),
+             db_->nodeName(item.node_id).c_str(),
+             db_->functionName(item.function_id).c_str(),
+             db_->fileName(item.file_id).c_str(),
              item.line);
+
+    QString repeats;
+    if (item.repeat_count > 1) {
+      repeats = QString("Repeated: %1 times (last at %2.%3)\n\n")
+        .arg(item.repeat_count)
+        .arg(item.last_stamp.sec)
+        .arg(item.last_stamp.nsec, 9, 10, QChar('0'));
+    }
     
     QString text = (QString(buffer) +
-                    item.text.join("\n") + 
+                    repeats +
+                    db_->text(item).join("\n") + 
                     QString("</p>"));
                             
     return QVariant(text);
@@ -461,13 +460,13 @@ QVariant LogDatabaseProxyModel::data(
              "Message: ",
              item.stamp.sec,
              item.stamp.nsec,
-             item.node.c_str(),
-             item.function.c_str(),
-             item.file.c_str(),
+             db_->nodeName(item.node_id).c_str(),
+             db_->functionName(item.function_id).c_str(),
+             db_->fileName(item.file_id).c_str(),
              item.line);
     
     QString text = (QString(buffer) +
-                    item.text.join("\n")); 
+                    db_->text(item).join("\n")); 
                             
     return QVariant(text);
   }
@@ -475,79 +474,185 @@ QVariant LogDatabaseProxyModel::data(
   return QVariant();
 }
 
+ros::Time LogDatabaseProxyModel::rowStamp(int row) const
+{
+  if (row < 0 || static_cast<size_t>(row) >= msg_mapping_.size()) {
+    return ros::Time();
+  }
+  return db_->log()[msg_mapping_[row].log_index].stamp;
+}
+
 void LogDatabaseProxyModel::reset()
 {
   beginResetModel();
-  msg_mapping_.clear();
+  clearInBackground(msg_mapping_);
   early_mapping_.clear();
   earliest_log_index_ = db_->log().size();
   latest_log_index_ = earliest_log_index_;
+
+  if (!template_ids_.empty()) {
+    // When drilling into templates, the database already knows which
+    // entries match them, so we can map them directly instead of
+    // scanning the entire log in the background.
+    std::vector<size_t> members;
+    for (std::set<uint32_t>::const_iterator it = template_ids_.begin();
+         it != template_ids_.end();
+         ++it)
+    {
+      if (*it >= db_->templateCount()) {
+        continue;
+      }
+      const std::vector<size_t> &ids = db_->logTemplate(*it).members;
+      std::vector<size_t>::const_iterator end = std::lower_bound(
+        ids.begin(), ids.end(), latest_log_index_);
+      members.insert(members.end(), ids.begin(), end);
+    }
+    std::sort(members.begin(), members.end());
+
+    for (size_t i = 0; i < members.size(); i++) {
+      const LogEntry &item = db_->log()[members[i]];
+      if (!acceptLogEntry(item)) {
+        continue;
+      }
+      for (uint32_t j = 0; j < item.line_count; j++) {
+        msg_mapping_.push_back(LineMap(members[i], j));
+      }
+    }
+    earliest_log_index_ = 0;
+  }
+
   endResetModel();
   scheduleIdleProcessing();
 }
 
 
-void LogDatabaseProxyModel::saveToFile(const QString& filename) const
+LogExportJob LogDatabaseProxyModel::exportJob(const QString& filename) const
 {
-  if (filename.endsWith(".bag", Qt::CaseInsensitive)) {
-    saveBagFile(filename);
-  }
-  else {
-    saveTextFile(filename);
+  // The mapping has a row per line; the export wants each entry once.
+  std::vector<size_t> entries;
+  for (size_t i = 0; i < msg_mapping_.size(); i++) {
+    if (msg_mapping_[i].line_index == 0) {
+      entries.push_back(msg_mapping_[i].log_index);
+    }
   }
+  return makeExportJob(filename, &entries);
 }
 
-void LogDatabaseProxyModel::saveBagFile(const QString& filename) const
+LogExportJob LogDatabaseProxyModel::exportJob(const QString& filename,
+                                              const ros::Time& begin,
+                                              const ros::Time& end) const
 {
-  rosbag::Bag bag(filename.toStdString().c_str(), rosbag::bagmode::Write);
+  // The store knows the range of stamps in each of its chunks, so only
+  // the rows of chunks that overlap the range are looked at.  Rows are
+  // ordered by log index, so a chunk's rows are found with a binary
+  // search.
+  const LogStore &log = db_->log();
+  const size_t chunk_size = LogStore::chunkSize();
 
-  size_t idx = 0;
-  while (idx < msg_mapping_.size()) {
-    const LineMap line_map = msg_mapping_[idx];    
-    const LogEntry &item = db_->log()[line_map.log_index];
-    
-    rosgraph_msgs::Log log;
-    log.file = item.file;
-    log.function = item.function;
-    log.header.seq = item.seq;
-    if (item.stamp < ros::TIME_MIN) {
-      // Note: I think TIME_MIN is the minimum representation of
-      // ros::Time, so this branch should be impossible.  Nonetheless,
-      // it doesn't hurt.
-      log.header.stamp = ros::Time::now();
-      qWarning("Msg with seq %d had time (%d); it's less than ros::TIME_MIN, which is invalid. "
-               "Writing 'now' instead.",
-               log.header.seq, item.stamp.sec);
-    } else {
-      log.header.stamp = item.stamp;
+  std::vector<size_t> entries;
+  for (size_t chunk = 0; chunk < log.chunkCount(); chunk++) {
+    if (log.chunkMaxStamp(chunk) < begin || log.chunkMinStamp(chunk) > end) {
+      continue;
     }
-    log.level = item.level;
-    log.line = item.line;
-    log.msg = item.text.join("\n").toStdString();
-    log.name = item.node;
-    bag.write("/rosout", log.header.stamp, log);
-
-    // Advance to the next line with a different log index.
-    idx++;
-    while (idx < msg_mapping_.size() && msg_mapping_[idx].log_index == line_map.log_index) {
-      idx++;
+
+    std::deque<LineMap>::const_iterator row = std::lower_bound(
+      msg_mapping_.begin(), msg_mapping_.end(),
+      LineMap(chunk * chunk_size, 0), lineMapLess);
+    for (; row != msg_mapping_.end() && row->log_index < (chunk + 1) * chunk_size; ++row) {
+      if (row->line_index != 0) {
+        continue;
+      }
+      const ros::Time &stamp = log[row->log_index].stamp;
+      if (stamp >= begin && stamp <= end) {
+        entries.push_back(row->log_index);
+      }
     }
   }
-  bag.close();
+  return makeExportJob(filename, &entries);
 }
 
-void LogDatabaseProxyModel::saveTextFile(const QString& filename) const
+LogExportJob LogDatabaseProxyModel::exportJob(const QString& filename,
+                                              const QItemSelection& selection) const
 {
-  QFile outFile(filename);
-  outFile.open(QFile::WriteOnly);
-  QTextStream outstream(&outFile);
-  for(size_t i = 0; i < msg_mapping_.size(); i++)
-  {
-    QString line = data(index(i), Qt::DisplayRole).toString();
-    outstream << line << '\n';
+  // Selected rows map straight to their entries.  A multi-line entry
+  // is exported if any of its lines is selected.
+  std::vector<size_t> entries;
+  for (int i = 0; i < selection.size(); i++) {
+    const int top = std::max(selection[i].top(), 0);
+    const int bottom = std::min<int>(selection[i].bottom(), msg_mapping_.size() - 1);
+    for (int row = top; row <= bottom; row++) {
+      entries.push_back(msg_mapping_[row].log_index);
+    }
+  }
+  std::sort(entries.begin(), entries.end());
+  entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+  return makeExportJob(filename, &entries);
+}
+
+LogExportJob LogDatabaseProxyModel::makeExportJob(const QString& filename,
+                                                  std::vector<size_t>* entries) const
+{
+  LogExportJob job;
+  job.filename = filename;
+
+  // A ".gz" suffix compresses any of the text based formats,
+  // e.g. "run.jsonl.gz".
+  QString name = filename;
+  if (name.endsWith(".gz", Qt::CaseInsensitive)) {
+    job.compress = true;
+    name.chop(3);
+  }
+
+  // Bags and sessions aren't compressed, so they are written without
+  // the ".gz" suffix rather than under a name that doesn't match.
+  if (name.endsWith(".bag", Qt::CaseInsensitive)) {
+    job.format = LogExportJob::BAG;
+    job.compress = false;
+    job.filename = name;
+  } else if (name.endsWith(".swcs", Qt::CaseInsensitive)) {
+    job.format = LogExportJob::SESSION;
+    job.compress = false;
+    job.filename = name;
+  } else if (name.endsWith(".jsonl", Qt::CaseInsensitive)) {
+    job.format = LogExportJob::JSON_LINES;
+  } else if (name.endsWith(".csv", Qt::CaseInsensitive)) {
+    job.format = LogExportJob::CSV;
+  } else {
+    job.format = LogExportJob::TEXT;
+  }
+
+  job.log = db_->snapshot();
+  job.entries.swap(*entries);
+  job.repeat_counts.reserve(job.entries.size());
+  job.last_stamps.reserve(job.entries.size());
+  for (size_t i = 0; i < job.entries.size(); i++) {
+    const LogEntry &item = job.log[job.entries[i]];
+    job.repeat_counts.push_back(item.repeat_count);
+    job.last_stamps.push_back(item.last_stamp);
+  }
+
+  job.node_names.reserve(db_->nodeCount());
+  for (size_t i = 0; i < db_->nodeCount(); i++) {
+    job.node_names.push_back(db_->nodeName(i));
+  }
+  job.file_names.reserve(db_->fileCount());
+  for (size_t i = 0; i < db_->fileCount(); i++) {
+    job.file_names.push_back(db_->fileName(i));
+  }
+  job.function_names.reserve(db_->functionCount());
+  for (size_t i = 0; i < db_->functionCount(); i++) {
+    job.function_names.push_back(db_->functionName(i));
+  }
+  job.template_patterns.reserve(db_->templateCount());
+  for (size_t i = 0; i < db_->templateCount(); i++) {
+    job.template_patterns.push_back(db_->logTemplate(i).pattern);
   }
-  outstream.flush();
-  outFile.close();
+  job.body_sources = db_->bodySources();
+
+  job.display_time = display_time_;
+  job.absolute_time = display_absolute_time_;
+  job.min_time = db_->minTime();
+  return job;
 }
 
 void LogDatabaseProxyModel::handleDatabaseCleared()
@@ -556,6 +661,16 @@ void LogDatabaseProxyModel::handleDatabaseCleared()
   clearSearchFailure();  // reset failed search variables, VCM 26 April 2017
 }
 
+void LogDatabaseProxyModel::handleMessagesUpdated()
+{
+  // Entries that have already been mapped had their repeat counts
+  // changed.  The view only repaints the visible rows, so it's cheap
+  // to mark everything as changed.
+  if (msg_mapping_.size()) {
+    Q_EMIT dataChanged(index(0), index(msg_mapping_.size() - 1));
+  }
+}
+
 void LogDatabaseProxyModel::processNewMessages()
 {
   std::deque<LineMap> new_items;
@@ -571,7 +686,7 @@ void LogDatabaseProxyModel::processNewMessages()
       continue;
     }    
 
-    for (int i = 0; i < item.text.size(); i++) {
+    for (uint32_t i = 0; i < item.line_count; i++) {
       new_items.push_back(LineMap(latest_log_index_, i));
     }
   }
@@ -608,10 +723,10 @@ void LogDatabaseProxyModel::processOldMessages()
       continue;
     }
 
-    for (int i = 0; i < item.text.size(); i++) {
+    for (uint32_t i = 0; i < item.line_count; i++) {
       // Note that we have to add the lines backwards to maintain the proper order.
       early_mapping_.push_front(
-        LineMap(earliest_log_index_-1, item.text.size()-1-i));
+        LineMap(earliest_log_index_-1, item.line_count-1-i));
     }
   }
  
@@ -647,7 +762,11 @@ bool LogDatabaseProxyModel::acceptLogEntry(const LogEntry &item)
     return false;
   }
   
-  if (names_.count(item.node) == 0) {
+  if (!acceptNode(item.node_id)) {
+    return false;
+  }
+
+  if (!template_ids_.empty() && template_ids_.count(item.template_id) == 0) {
     return false;
   }
 
@@ -661,10 +780,10 @@ bool LogDatabaseProxyModel::acceptLogEntry(const LogEntry &item)
     // across the new lines.
     
     // Don't let an empty regexp filter out everything
-    return exclude_regexp_.isEmpty() || exclude_regexp_.indexIn(item.text.join(" ")) < 0;
+    return exclude_regexp_.isEmpty() || exclude_regexp_.indexIn(db_->text(item).join(" ")) < 0;
   } else {
     for (int i = 0; i < exclude_strings_.size(); i++) {
-      if (item.text.join(" ").contains(exclude_strings_[i], Qt::CaseInsensitive)) {
+      if (db_->text(item).join(" ").contains(exclude_strings_[i], Qt::CaseInsensitive)) {
         return false;
       }
     }
@@ -673,20 +792,45 @@ bool LogDatabaseProxyModel::acceptLogEntry(const LogEntry &item)
   return true;
 }
 
+bool LogDatabaseProxyModel::acceptNode(uint32_t node_id)
+{
+  if (node_id >= node_filter_.size()) {
+    node_filter_.resize(db_->nodeCount(), NODE_UNKNOWN);
+  }
+
+  if (node_filter_[node_id] == NODE_UNKNOWN) {
+    const std::string &name = db_->nodeName(node_id);
+    bool accepted = names_.count(name) != 0;
+
+    // This is only evaluated once per node, so a linear scan of the
+    // prefixes is fine.
+    for (std::set<std::string>::const_iterator it = prefixes_.begin();
+         !accepted && it != prefixes_.end();
+         ++it)
+    {
+      accepted = name.compare(0, it->size(), *it) == 0;
+    }
+
+    node_filter_[node_id] = accepted ? NODE_ACCEPTED : NODE_REJECTED;
+  }
+
+  return node_filter_[node_id] == NODE_ACCEPTED;
+}
+
 // Return true if the item message contains at least one of the
 // strings in include_filter_.  Always returns true if there are no
 // include strings.
 bool LogDatabaseProxyModel::testIncludeFilter(const LogEntry &item)
 {
   if (use_regular_expressions_) {
-    return include_regexp_.indexIn(item.text.join(" ")) >= 0;
+    return include_regexp_.indexIn(db_->text(item).join(" ")) >= 0;
   } else {
     if (include_strings_.empty()) {
       return true;
     }
 
     for (int i = 0; i < include_strings_.size(); i++) {
-      if (item.text.join(" ").contains(include_strings_[i], Qt::CaseInsensitive)) {
+      if (db_->text(item).join(" ").contains(include_strings_[i], Qt::CaseInsensitive)) {
         return true;
       }
     }
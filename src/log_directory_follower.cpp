@@ -0,0 +1,317 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#include <cstring>
+
+#include <boost/functional/hash.hpp>
+#include <boost/make_shared.hpp>
+
+#include <QDir>
+#include <QFile>
+#include <QFileSystemWatcher>
+#include <QTimer>
+
+#include <swri_console/log_directory_follower.h>
+#include <swri_console/text_log_reader.h>
+
+namespace swri_console
+{
+  // Number of recently delivered messages that are remembered for
+  // removing duplicates.
+  static const size_t MAX_SEEN = 100000;
+  // The last message of a file is delivered after this long if no more
+  // lines are written to it.
+  static const int FLUSH_DELAY_MS = 250;
+  // Appended data is read in blocks of this many bytes.
+  static const qint64 READ_BLOCK_SIZE = 4 << 20;
+
+  LogDirectoryFollower::LogDirectoryFollower() :
+    watcher_(NULL),
+    flush_timer_(NULL),
+    next_file_id_(0)
+  {
+    clock_.start();
+  }
+
+  void LogDirectoryFollower::follow(const QString& directory)
+  {
+    stop();
+
+    // Created here rather than in the constructor, so that they belong
+    // to the thread the follower was moved to.
+    if (!watcher_) {
+      watcher_ = new QFileSystemWatcher(this);
+      QObject::connect(watcher_, SIGNAL(directoryChanged(const QString&)),
+                       this, SLOT(handleDirectoryChanged(const QString&)));
+      QObject::connect(watcher_, SIGNAL(fileChanged(const QString&)),
+                       this, SLOT(handleFileChanged(const QString&)));
+
+      flush_timer_ = new QTimer(this);
+      flush_timer_->setSingleShot(true);
+      flush_timer_->setInterval(FLUSH_DELAY_MS);
+      QObject::connect(flush_timer_, SIGNAL(timeout()),
+                       this, SLOT(flushPending()));
+    }
+
+    directory_ = directory;
+    watcher_->addPath(directory_);
+    scanDirectory();
+  }
+
+  void LogDirectoryFollower::stop()
+  {
+    if (!watcher_) {
+      return;
+    }
+
+    if (!watcher_->files().isEmpty()) {
+      watcher_->removePaths(watcher_->files());
+    }
+    if (!watcher_->directories().isEmpty()) {
+      watcher_->removePaths(watcher_->directories());
+    }
+    flush_timer_->stop();
+    flushFiles(true);
+
+    directory_.clear();
+    files_.clear();
+  }
+
+  void LogDirectoryFollower::handleDirectoryChanged(const QString&)
+  {
+    scanDirectory();
+  }
+
+  void LogDirectoryFollower::handleFileChanged(const QString& path)
+  {
+    // Files that are replaced stop being watched.
+    if (!watcher_->files().contains(path) && QFile::exists(path)) {
+      watcher_->addPath(path);
+    }
+
+    MessageList msgs;
+    readFile(path, &msgs);
+    if (!msgs.empty()) {
+      emit messagesRead(msgs);
+    }
+    startFlushTimer();
+  }
+
+  void LogDirectoryFollower::scanDirectory()
+  {
+    if (directory_.isEmpty()) {
+      return;
+    }
+
+    // The master and roslaunch logs don't hold node messages.
+    QDir dir(directory_);
+    QStringList names = dir.entryList(QStringList("*.log"), QDir::Files, QDir::Name);
+
+    MessageList msgs;
+    for (int i = 0; i < names.size(); i++) {
+      if (names[i] == "master.log" || names[i].startsWith("roslaunch-")) {
+        continue;
+      }
+
+      const QString path = dir.filePath(names[i]);
+      if (files_.contains(path)) {
+        continue;
+      }
+
+      FileState state;
+      state.id = next_file_id_++;
+      state.node = textLogNodeName(path);
+      files_.insert(path, state);
+      watcher_->addPath(path);
+      readFile(path, &msgs);
+    }
+
+    if (!msgs.empty()) {
+      emit messagesRead(msgs);
+    }
+    startFlushTimer();
+  }
+
+  void LogDirectoryFollower::readFile(const QString& path, MessageList* msgs)
+  {
+    QHash<QString, FileState>::iterator it = files_.find(path);
+    if (it == files_.end()) {
+      return;
+    }
+    FileState& state = it.value();
+    state.changed_ms = clock_.elapsed();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+      return;
+    }
+
+    if (file.size() < state.offset) {
+      // The file was truncated or replaced, so start over.
+      if (state.pending) {
+        deliver(state.pending, state.id, msgs);
+        state.pending.reset();
+      }
+      state.offset = 0;
+    }
+
+    rosgraph_msgs::LogPtr log = boost::make_shared<rosgraph_msgs::Log>();
+    while (file.seek(state.offset)) {
+      QByteArray data = file.read(READ_BLOCK_SIZE);
+      if (data.isEmpty()) {
+        break;
+      }
+
+      // Only complete lines are parsed.  A partial line is read again
+      // once the rest of it has been written, unless it fills a whole
+      // block by itself.
+      int size = data.lastIndexOf('\n') + 1;
+      if (size == 0) {
+        if (data.size() < READ_BLOCK_SIZE) {
+          break;
+        }
+        size = data.size();
+      }
+
+      const char* p = data.constData();
+      const char* end = p + size;
+      while (p < end) {
+        const char* line_end = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!line_end) {
+          line_end = end;
+        }
+        const char* content_end = line_end;
+        if (content_end > p && *(content_end - 1) == '\r') {
+          content_end--;
+        }
+
+        if (parseTextLogRecord(p, content_end, state.node, log.get())) {
+          if (state.pending) {
+            deliver(state.pending, state.id, msgs);
+          }
+          log->header.seq = state.seq++;
+          state.pending = log;
+          log = boost::make_shared<rosgraph_msgs::Log>();
+        } else if (state.pending) {
+          // A continuation of a multi-line message.
+          state.pending->msg += '\n';
+          state.pending->msg.append(p, content_end);
+        }
+
+        p = line_end + 1;
+      }
+
+      state.offset += size;
+      if (data.size() < READ_BLOCK_SIZE) {
+        break;
+      }
+    }
+  }
+
+  void LogDirectoryFollower::flushPending()
+  {
+    flushFiles(false);
+  }
+
+  void LogDirectoryFollower::flushFiles(bool all)
+  {
+    // Each file's last message is delivered once that file has been
+    // quiet for a while, however busy the other files are.
+    const qint64 now = clock_.elapsed();
+    bool waiting = false;
+    MessageList msgs;
+    for (QHash<QString, FileState>::iterator it = files_.begin(); it != files_.end(); ++it) {
+      FileState& state = it.value();
+      if (!state.pending) {
+        continue;
+      }
+      if (all || now - state.changed_ms >= FLUSH_DELAY_MS) {
+        deliver(state.pending, state.id, &msgs);
+        state.pending.reset();
+      } else {
+        waiting = true;
+      }
+    }
+
+    if (!msgs.empty()) {
+      emit messagesRead(msgs);
+    }
+    if (waiting) {
+      startFlushTimer();
+    }
+  }
+
+  void LogDirectoryFollower::startFlushTimer()
+  {
+    // Restarting the timer on every change would put off flushing
+    // forever while any file is busy.
+    if (!flush_timer_->isActive()) {
+      flush_timer_->start();
+    }
+  }
+
+  void LogDirectoryFollower::deliver(const rosgraph_msgs::LogPtr& log, uint32_t file_id, MessageList* msgs)
+  {
+    // Files don't agree on the precision of the stamp, or on the node's
+    // namespace, so messages are identified by the last part of the
+    // node name, their text and their stamp in milliseconds.  Only a
+    // copy from another file is a duplicate; a node may log the same
+    // text twice in a millisecond.
+    const quint64 msecs = static_cast<quint64>(log->header.stamp.sec) * 1000 +
+      log->header.stamp.nsec / 1000000;
+    // Node logs of namespaced nodes are named like "ns-node-1.log", and
+    // ROS names can't contain '-', so either separator ends the
+    // namespace.
+    const size_t separator = log->name.find_last_of("/-");
+    const size_t basename = separator == std::string::npos ? 0 : separator + 1;
+
+    size_t seed = 0;
+    boost::hash_combine(seed, boost::hash_range(log->name.begin() + basename, log->name.end()));
+    boost::hash_combine(seed, log->msg);
+    boost::hash_combine(seed, msecs);
+    const quint64 key = seed;
+
+    QHash<quint64, uint32_t>::const_iterator it = seen_.find(key);
+    if (it != seen_.end()) {
+      if (it.value() != file_id) {
+        return;
+      }
+    } else {
+      seen_.insert(key, file_id);
+      seen_order_.push_back(key);
+      if (seen_order_.size() > MAX_SEEN) {
+        seen_.remove(seen_order_.front());
+        seen_order_.pop_front();
+      }
+    }
+
+    msgs->push_back(log);
+  }
+}
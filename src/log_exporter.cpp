@@ -0,0 +1,720 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+
+#include <zlib.h>
+
+#include <QFile>
+#include <QMessageBox>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QProgressDialog>
+#include <QSaveFile>
+#include <QWaitCondition>
+
+#include <rosbag/bag.h>
+#include <rosgraph_msgs/Log.h>
+
+#include <swri_console/log_exporter.h>
+#include <swri_console/session_file.h>
+
+namespace swri_console
+{
+  // Text that isn't in memory is fetched in pages of this many messages.
+  static const uint64_t TEXT_PAGE_SIZE = 256;
+  // Formatted text is collected in a buffer of about this many bytes
+  // before it is written to the file.
+  static const int WRITE_BUFFER_SIZE = 1 << 20;
+
+  // Compressed output is queued for the compression thread in blocks;
+  // formatting waits once this many blocks are pending.
+  static const size_t MAX_PENDING_BLOCKS = 4;
+
+  namespace
+  {
+    const char* levelName(uint8_t level)
+    {
+      switch (level) {
+        case rosgraph_msgs::Log::DEBUG: return "DEBUG";
+        case rosgraph_msgs::Log::INFO: return "INFO";
+        case rosgraph_msgs::Log::WARN: return "WARN";
+        case rosgraph_msgs::Log::ERROR: return "ERROR";
+        case rosgraph_msgs::Log::FATAL: return "FATAL";
+        default: return "UNKNOWN";
+      }
+    }
+
+    void appendStamp(QByteArray* buffer, const ros::Time& stamp)
+    {
+      char text[32];
+      int len = snprintf(text, sizeof(text), "%u.%09u", stamp.sec, stamp.nsec);
+      buffer->append(text, len);
+    }
+
+    void appendJsonString(QByteArray* buffer, const char* data, size_t size)
+    {
+      buffer->append('"');
+      for (size_t i = 0; i < size; i++) {
+        const unsigned char c = data[i];
+        if (c == '"') {
+          buffer->append("\\\"");
+        } else if (c == '\\') {
+          buffer->append("\\\\");
+        } else if (c == '\n') {
+          buffer->append("\\n");
+        } else if (c == '\r') {
+          buffer->append("\\r");
+        } else if (c == '\t') {
+          buffer->append("\\t");
+        } else if (c < 0x20) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          buffer->append(escaped);
+        } else {
+          buffer->append(static_cast<char>(c));
+        }
+      }
+      buffer->append('"');
+    }
+
+    void appendJsonString(QByteArray* buffer, const std::string& str)
+    {
+      appendJsonString(buffer, str.data(), str.size());
+    }
+
+    void appendJsonString(QByteArray* buffer, const QByteArray& str)
+    {
+      appendJsonString(buffer, str.constData(), str.size());
+    }
+
+    // Fields are only quoted when they need to be (RFC 4180).
+    void appendCsvField(QByteArray* buffer, const char* data, size_t size)
+    {
+      bool quote = false;
+      for (size_t i = 0; i < size && !quote; i++) {
+        quote = (data[i] == ',' || data[i] == '"' || data[i] == '\n' || data[i] == '\r');
+      }
+
+      if (!quote) {
+        buffer->append(data, size);
+        return;
+      }
+
+      buffer->append('"');
+      for (size_t i = 0; i < size; i++) {
+        if (data[i] == '"') {
+          buffer->append('"');
+        }
+        buffer->append(data[i]);
+      }
+      buffer->append('"');
+    }
+
+    void appendCsvField(QByteArray* buffer, const std::string& str)
+    {
+      appendCsvField(buffer, str.data(), str.size());
+    }
+
+    void appendCsvField(QByteArray* buffer, const QByteArray& str)
+    {
+      appendCsvField(buffer, str.constData(), str.size());
+    }
+
+    /**
+     * Writes blocks of formatted output to a file.  With compression
+     * enabled, blocks are queued for a second thread that gzips and
+     * writes them, so formatting and compression run in parallel.  The
+     * file is only replaced when the output is committed.
+     */
+    class ExportOutput : public QThread
+    {
+    public:
+      ExportOutput(const QString& filename, bool compress) :
+        file_(filename),
+        compress_(compress),
+        closed_(false),
+        failed_(false)
+      {
+      }
+
+      ~ExportOutput()
+      {
+        abort();
+      }
+
+      bool open()
+      {
+        if (!file_.open(QIODevice::WriteOnly)) {
+          error_ = file_.errorString();
+          return false;
+        }
+
+        if (compress_) {
+          memset(&stream_, 0, sizeof(stream_));
+          // Adding 16 to the window bits makes zlib write a gzip header
+          // and trailer instead of a zlib one.
+          if (deflateInit2(&stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                           16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            error_ = QString("Failed to initialize compression");
+            file_.cancelWriting();
+            return false;
+          }
+          start();
+        }
+        return true;
+      }
+
+      /**
+       * Writes a block, or queues it for compression.  Returns false if
+       * the output has failed.
+       */
+      bool write(const QByteArray& block)
+      {
+        if (!compress_) {
+          if (file_.write(block) != block.size()) {
+            error_ = file_.errorString();
+            return false;
+          }
+          return true;
+        }
+
+        QMutexLocker lock(&mutex_);
+        while (blocks_.size() >= MAX_PENDING_BLOCKS && !failed_) {
+          not_full_.wait(&mutex_);
+        }
+        if (failed_) {
+          return false;
+        }
+        blocks_.push_back(block);
+        not_empty_.wakeOne();
+        return true;
+      }
+
+      /**
+       * Finishes compressing and replaces the file.
+       */
+      bool commit()
+      {
+        if (compress_) {
+          {
+            QMutexLocker lock(&mutex_);
+            closed_ = true;
+            not_empty_.wakeOne();
+          }
+          wait();
+          if (failed_) {
+            file_.cancelWriting();
+            return false;
+          }
+        }
+
+        if (!file_.commit()) {
+          error_ = file_.errorString();
+          return false;
+        }
+        return true;
+      }
+
+      /**
+       * Discards the output.  Called automatically if the output isn't
+       * committed.
+       */
+      void abort()
+      {
+        if (isRunning()) {
+          {
+            QMutexLocker lock(&mutex_);
+            failed_ = true;
+            blocks_.clear();
+            not_empty_.wakeOne();
+          }
+          wait();
+        }
+        file_.cancelWriting();
+      }
+
+      const QString& errorString() const { return error_; }
+
+    protected:
+      void run()
+      {
+        QByteArray out(WRITE_BUFFER_SIZE / 4, 0);
+
+        bool done = false;
+        while (!done) {
+          QByteArray block;
+          {
+            QMutexLocker lock(&mutex_);
+            while (blocks_.empty() && !closed_ && !failed_) {
+              not_empty_.wait(&mutex_);
+            }
+            if (failed_) {
+              break;
+            }
+            if (blocks_.empty()) {
+              // Closed and drained; flush the rest of the stream.
+              done = true;
+            } else {
+              block = blocks_.front();
+              blocks_.pop_front();
+              not_full_.wakeOne();
+            }
+          }
+
+          stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(block.constData()));
+          stream_.avail_in = block.size();
+          do {
+            stream_.next_out = reinterpret_cast<Bytef*>(out.data());
+            stream_.avail_out = out.size();
+            deflate(&stream_, done ? Z_FINISH : Z_NO_FLUSH);
+
+            const int size = out.size() - stream_.avail_out;
+            if (size > 0 && file_.write(out.constData(), size) != size) {
+              QMutexLocker lock(&mutex_);
+              error_ = file_.errorString();
+              failed_ = true;
+              not_full_.wakeAll();
+              done = true;
+              break;
+            }
+          } while (stream_.avail_out == 0);
+        }
+
+        deflateEnd(&stream_);
+      }
+
+    private:
+      QSaveFile file_;
+      bool compress_;
+      QString error_;
+      z_stream stream_;
+
+      QMutex mutex_;
+      QWaitCondition not_empty_;
+      QWaitCondition not_full_;
+      std::deque<QByteArray> blocks_;
+      bool closed_;
+      bool failed_;
+    };
+  }
+
+  int formatLogHeader(char* buffer, size_t size,
+                      uint8_t level,
+                      const ros::Time& stamp,
+                      const ros::Time& min_time,
+                      bool display_time,
+                      bool absolute_time)
+  {
+    char level_char = '?';
+    if (level == rosgraph_msgs::Log::DEBUG) {
+      level_char = 'D';
+    } else if (level == rosgraph_msgs::Log::INFO) {
+      level_char = 'I';
+    } else if (level == rosgraph_msgs::Log::WARN) {
+      level_char = 'W';
+    } else if (level == rosgraph_msgs::Log::ERROR) {
+      level_char = 'E';
+    } else if (level == rosgraph_msgs::Log::FATAL) {
+      level_char = 'F';
+    }
+
+    if (!display_time) {
+      return snprintf(buffer, size, "[%c] ", level_char);
+    }
+
+    char time[128];
+    if (absolute_time) {
+      snprintf(time, sizeof(time),
+               "%u.%09u",
+               stamp.sec,
+               stamp.nsec);
+    } else {
+      ros::Duration t = stamp - min_time;
+
+      int32_t secs = t.sec;
+      int hours = secs / 60 / 60;
+      int minutes = (secs / 60) % 60;
+      int seconds = (secs % 60);
+      int milliseconds = t.nsec / 1000000;
+
+      snprintf(time, sizeof(time),
+               "%d:%02d:%02d:%03d",
+               hours, minutes, seconds, milliseconds);
+    }
+
+    return snprintf(buffer, size, "[%c %s] ", level_char, time);
+  }
+
+  LogExportThread::LogExportThread(const LogExportJob& job) :
+    job_(job),
+    cancelled_(false),
+    last_progress_(-1),
+    page_source_(0),
+    page_first_(0)
+  {
+  }
+
+  void LogExportThread::cancel()
+  {
+    cancelled_ = true;
+  }
+
+  void LogExportThread::run()
+  {
+    switch (job_.format) {
+      case LogExportJob::BAG:
+        writeBagFile();
+        break;
+      case LogExportJob::SESSION:
+        writeSessionFile();
+        break;
+      case LogExportJob::TEXT:
+      case LogExportJob::JSON_LINES:
+      case LogExportJob::CSV:
+        writeFormattedFile();
+        break;
+    }
+  }
+
+  const QStringList& LogExportThread::text(const LogEntry& entry)
+  {
+    if (!entry.text.isEmpty() || entry.body_source >= job_.body_sources.size()) {
+      return entry.text;
+    }
+
+    // Entries are exported in order, so consecutive entries almost
+    // always come from the same page.
+    const uint64_t first = entry.body_locator - (entry.body_locator % TEXT_PAGE_SIZE);
+    if (page_source_ != entry.body_source || page_first_ != first || page_.empty()) {
+      job_.body_sources[entry.body_source]->textRange(first, TEXT_PAGE_SIZE, &page_);
+      page_source_ = entry.body_source;
+      page_first_ = first;
+    }
+
+    padded_text_.clear();
+    const uint64_t offset = entry.body_locator - first;
+    if (offset < page_.size()) {
+      padded_text_ = page_[offset];
+    }
+    // Keep the line count consistent with the display if the source
+    // couldn't be read.
+    while (padded_text_.size() < static_cast<int>(entry.line_count)) {
+      padded_text_.append(QString());
+    }
+    return padded_text_;
+  }
+
+  void LogExportThread::reportProgress(size_t done)
+  {
+    int permille = static_cast<int>(done * 1000 / job_.entries.size());
+    if (permille != last_progress_) {
+      last_progress_ = permille;
+      emit progress(permille);
+    }
+  }
+
+  void LogExportThread::writeBagFile()
+  {
+    try
+    {
+      rosbag::Bag bag(job_.filename.toStdString(), rosbag::bagmode::Write);
+
+      for (size_t i = 0; i < job_.entries.size() && !cancelled_; i++) {
+        const LogEntry &item = job_.log[job_.entries[i]];
+
+        rosgraph_msgs::Log log;
+        log.file = job_.file_names[item.file_id];
+        log.function = job_.function_names[item.function_id];
+        log.header.seq = item.seq;
+        if (item.stamp < ros::TIME_MIN) {
+          // Note: I think TIME_MIN is the minimum representation of
+          // ros::Time, so this branch should be impossible.  Nonetheless,
+          // it doesn't hurt.
+          log.header.stamp = ros::Time::now();
+          qWarning("Msg with seq %d had time (%d); it's less than ros::TIME_MIN, which is invalid. "
+                   "Writing 'now' instead.",
+                   log.header.seq, item.stamp.sec);
+        } else {
+          log.header.stamp = item.stamp;
+        }
+        log.level = item.level;
+        log.line = item.line;
+        log.msg = text(item).join("\n").toStdString();
+        log.name = job_.node_names[item.node_id];
+        bag.write("/rosout", log.header.stamp, log);
+
+        reportProgress(i + 1);
+      }
+      bag.close();
+    }
+    catch (const rosbag::BagException& e)
+    {
+      error_ = QString::fromStdString(e.what());
+    }
+
+    // A bag is written in place, so a partial one has to be removed.
+    if (cancelled_ || !error_.isEmpty()) {
+      QFile::remove(job_.filename);
+    }
+  }
+
+  void LogExportThread::writeSessionFile()
+  {
+    SessionWriter writer(job_.filename);
+    if (!writer.open()) {
+      error_ = tr("Failed to open %1").arg(job_.filename);
+      return;
+    }
+
+    for (size_t i = 0; i < job_.entries.size() && !cancelled_; i++) {
+      const LogEntry &item = job_.log[job_.entries[i]];
+
+      writer.add(item,
+                 job_.node_names[item.node_id],
+                 job_.file_names[item.file_id],
+                 job_.function_names[item.function_id],
+                 job_.template_patterns[item.template_id].toUtf8(),
+                 job_.repeat_counts[i],
+                 job_.last_stamps[i],
+                 text(item));
+
+      reportProgress(i + 1);
+    }
+
+    // The writer only replaces the file when it is finished, so a
+    // cancelled export leaves the old file alone.
+    if (!cancelled_ && !writer.finish()) {
+      error_ = tr("Failed to write %1").arg(job_.filename);
+    }
+  }
+
+  void LogExportThread::appendText(QByteArray* buffer, size_t index, const LogEntry& item, const QStringList& lines)
+  {
+    char header[1024];
+    int len = formatLogHeader(header, sizeof(header),
+                              item.level, item.stamp, job_.min_time,
+                              job_.display_time, job_.absolute_time);
+    len = std::min<int>(len, sizeof(header) - 1);
+
+    for (int j = 0; j < lines.size(); j++) {
+      if (j == 0) {
+        buffer->append(header, len);
+        if (job_.repeat_counts[index] > 1) {
+          // Collapsed entries are prefixed with their repeat count,
+          // e.g. "×12", the same as in the display.
+          buffer->append("\xC3\x97");
+          buffer->append(QByteArray::number(job_.repeat_counts[index]));
+          buffer->append(' ');
+        }
+      } else {
+        // Subsequent lines are indented to line up with the first.
+        buffer->append(QByteArray(len, ' '));
+      }
+      buffer->append(lines[j].toUtf8());
+      buffer->append('\n');
+    }
+  }
+
+  void LogExportThread::appendJson(QByteArray* buffer, size_t index, const LogEntry& item, const QStringList& lines)
+  {
+    buffer->append("{\"stamp\":");
+    appendStamp(buffer, item.stamp);
+    buffer->append(",\"level\":\"");
+    buffer->append(levelName(item.level));
+    buffer->append("\",\"node\":");
+    appendJsonString(buffer, job_.node_names[item.node_id]);
+    buffer->append(",\"file\":");
+    appendJsonString(buffer, job_.file_names[item.file_id]);
+    buffer->append(",\"function\":");
+    appendJsonString(buffer, job_.function_names[item.function_id]);
+    buffer->append(",\"line\":");
+    buffer->append(QByteArray::number(item.line));
+    buffer->append(",\"seq\":");
+    buffer->append(QByteArray::number(item.seq));
+    buffer->append(",\"repeat_count\":");
+    buffer->append(QByteArray::number(job_.repeat_counts[index]));
+    buffer->append(",\"last_stamp\":");
+    appendStamp(buffer, job_.last_stamps[index]);
+    buffer->append(",\"text\":");
+    appendJsonString(buffer, lines.join("\n").toUtf8());
+    buffer->append("}\n");
+  }
+
+  void LogExportThread::appendCsv(QByteArray* buffer, size_t index, const LogEntry& item, const QStringList& lines)
+  {
+    appendStamp(buffer, item.stamp);
+    buffer->append(',');
+    buffer->append(levelName(item.level));
+    buffer->append(',');
+    appendCsvField(buffer, job_.node_names[item.node_id]);
+    buffer->append(',');
+    appendCsvField(buffer, job_.file_names[item.file_id]);
+    buffer->append(',');
+    appendCsvField(buffer, job_.function_names[item.function_id]);
+    buffer->append(',');
+    buffer->append(QByteArray::number(item.line));
+    buffer->append(',');
+    buffer->append(QByteArray::number(item.seq));
+    buffer->append(',');
+    buffer->append(QByteArray::number(job_.repeat_counts[index]));
+    buffer->append(',');
+    appendStamp(buffer, job_.last_stamps[index]);
+    buffer->append(',');
+    appendCsvField(buffer, lines.join("\n").toUtf8());
+    buffer->append('\n');
+  }
+
+  void LogExportThread::writeFormattedFile()
+  {
+    ExportOutput output(job_.filename, job_.compress);
+    if (!output.open()) {
+      error_ = output.errorString();
+      return;
+    }
+
+    // Entries are formatted straight into a byte buffer that is handed
+    // to the output in large blocks.
+    QByteArray buffer;
+    buffer.reserve(WRITE_BUFFER_SIZE + 4096);
+    if (job_.format == LogExportJob::CSV) {
+      buffer.append("stamp,level,node,file,function,line,seq,repeat_count,last_stamp,text\n");
+    }
+
+    for (size_t i = 0; i < job_.entries.size() && !cancelled_; i++) {
+      const LogEntry &item = job_.log[job_.entries[i]];
+      const QStringList &lines = text(item);
+
+      switch (job_.format) {
+        case LogExportJob::JSON_LINES:
+          appendJson(&buffer, i, item, lines);
+          break;
+        case LogExportJob::CSV:
+          appendCsv(&buffer, i, item, lines);
+          break;
+        default:
+          appendText(&buffer, i, item, lines);
+          break;
+      }
+
+      if (buffer.size() >= WRITE_BUFFER_SIZE) {
+        if (!output.write(buffer)) {
+          error_ = output.errorString();
+          break;
+        }
+        // The compression thread may still be holding on to the block,
+        // so start a new one instead of reusing it.
+        buffer = QByteArray();
+        buffer.reserve(WRITE_BUFFER_SIZE + 4096);
+      }
+
+      reportProgress(i + 1);
+    }
+
+    // Anything that doesn't make it to the commit is discarded, leaving
+    // the old file untouched.
+    if (cancelled_ || !error_.isEmpty()) {
+      return;
+    }
+
+    if (!output.write(buffer) || !output.commit()) {
+      error_ = output.errorString();
+    }
+  }
+
+  LogExporter::LogExporter() :
+    thread_(NULL),
+    progress_dialog_(NULL)
+  {
+  }
+
+  LogExporter::~LogExporter()
+  {
+    if (thread_)
+    {
+      thread_->cancel();
+      thread_->wait();
+      delete thread_;
+    }
+    delete progress_dialog_;
+  }
+
+  bool LogExporter::exportLogs(const LogExportJob& job)
+  {
+    if (thread_)
+    {
+      QMessageBox::information(NULL, tr("Save Logs"),
+                               tr("Logs are already being saved."));
+      return false;
+    }
+
+    thread_ = new LogExportThread(job);
+    QObject::connect(thread_, SIGNAL(finished()),
+                     this, SLOT(handleThreadFinished()));
+
+    progress_dialog_ = new QProgressDialog(tr("Saving %1...").arg(job.filename),
+                                           tr("Cancel"), 0, 1000);
+    progress_dialog_->setMinimumDuration(500);
+    QObject::connect(thread_, SIGNAL(progress(int)),
+                     progress_dialog_, SLOT(setValue(int)));
+    QObject::connect(progress_dialog_, SIGNAL(canceled()),
+                     this, SLOT(cancelExport()));
+
+    thread_->start();
+    return true;
+  }
+
+  void LogExporter::cancelExport()
+  {
+    if (thread_)
+    {
+      thread_->cancel();
+    }
+  }
+
+  void LogExporter::handleThreadFinished()
+  {
+    QString error = thread_->errorString();
+    thread_->deleteLater();
+    thread_ = NULL;
+    progress_dialog_->deleteLater();
+    progress_dialog_ = NULL;
+
+    if (!error.isEmpty())
+    {
+      QMessageBox::warning(NULL, tr("Save Logs"),
+                           tr("Failed to save logs: %1").arg(error));
+    }
+  }
+}
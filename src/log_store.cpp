@@ -0,0 +1,72 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#include <algorithm>
+
+#include <swri_console/log_store.h>
+
+namespace swri_console
+{
+LogStore::LogStore()
+  :
+  chunks_(new LogEntry*[MAX_CHUNKS]()),
+  appended_(0),
+  committed_(0),
+  snapshots_(0)
+{
+}
+
+LogStore::~LogStore()
+{
+  for (size_t i = 0; i < MAX_CHUNKS && chunks_[i]; i++) {
+    delete[] chunks_[i];
+  }
+  delete[] chunks_;
+}
+
+bool LogStore::append(const LogEntry &entry)
+{
+  const size_t chunk = appended_ >> CHUNK_BITS;
+  if (chunk >= MAX_CHUNKS) {
+    return false;
+  }
+
+  if (!chunks_[chunk]) {
+    chunks_[chunk] = new LogEntry[CHUNK_SIZE];
+    chunk_stamps_.push_back(std::make_pair(entry.stamp, entry.stamp));
+  }
+
+  chunks_[chunk][appended_ & CHUNK_MASK] = entry;
+  chunk_stamps_[chunk].first = std::min(chunk_stamps_[chunk].first, entry.stamp);
+  chunk_stamps_[chunk].second = std::max(chunk_stamps_[chunk].second, entry.stamp);
+  appended_++;
+  return true;
+}
+}  // namespace swri_console
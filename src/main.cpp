@@ -28,6 +28,8 @@
 //
 // *****************************************************************************
 
+#include <cstring>
+
 #include <QtGui>
 #include <QApplication>
 #include <QCoreApplication>
@@ -35,6 +37,7 @@
 #include <QStringList>
 
 #include <swri_console/console_master.h>
+#include <swri_console/master_source.h>
 
 void loadFonts()
 {
@@ -75,6 +78,14 @@ void loadFonts()
 
 int main(int argc, char **argv)
 {
+  // Additional ROS masters are read by running this executable as a
+  // relay, one process per master.
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], swri_console::MasterSource::RELAY_ARGUMENT) == 0) {
+      return swri_console::MasterSource::runRelay(argc, argv);
+    }
+  }
+
   QApplication app(argc, argv);
   loadFonts();
 
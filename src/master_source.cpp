@@ -0,0 +1,228 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <QCoreApplication>
+#include <QProcessEnvironment>
+#include <QStringList>
+#include <QTimer>
+
+#include <boost/make_shared.hpp>
+#include <ros/ros.h>
+#include <ros/serialization.h>
+
+#include <swri_console/master_source.h>
+
+namespace swri_console
+{
+  const char* const MasterSource::RELAY_ARGUMENT = "--rosout-relay";
+
+  namespace
+  {
+    const int MIN_RESTART_DELAY_MS = 1000;
+    const int MAX_RESTART_DELAY_MS = 60000;
+
+    // Messages received by the relay during the current spin,
+    // serialized and prefixed with their length.
+    std::vector<uint8_t> relay_output;
+
+    void relayMessage(const RosoutMessageConstPtr& msg)
+    {
+      const uint32_t length = ros::serialization::serializationLength(*msg);
+      const size_t offset = relay_output.size();
+      relay_output.resize(offset + sizeof(length) + length);
+      std::memcpy(&relay_output[offset], &length, sizeof(length));
+
+      ros::serialization::OStream stream(&relay_output[offset + sizeof(length)], length);
+      ros::serialization::serialize(stream, *msg);
+    }
+  }
+
+  MasterSource::MasterSource(int source_id, const QString& master_uri) :
+    source_id_(source_id),
+    master_uri_(master_uri),
+    relay_(NULL),
+    restart_timer_(new QTimer(this)),
+    restart_delay_ms_(MIN_RESTART_DELAY_MS)
+  {
+    restart_timer_->setSingleShot(true);
+    QObject::connect(restart_timer_, SIGNAL(timeout()),
+                     this, SLOT(start()));
+  }
+
+  MasterSource::~MasterSource()
+  {
+    stop();
+  }
+
+  int MasterSource::runRelay(int argc, char** argv)
+  {
+    // Messages are written to a private copy of standard output, and
+    // standard output itself is redirected to standard error, so that
+    // anything roscpp prints can't end up in the middle of them.
+    FILE* output = fdopen(dup(STDOUT_FILENO), "wb");
+    if (output == NULL || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+      return 1;
+    }
+    // If the console goes away, writing fails and the relay exits
+    // instead of being killed by SIGPIPE.
+    signal(SIGPIPE, SIG_IGN);
+
+    ros::init(argc, argv, "swri_console_relay",
+              ros::init_options::AnonymousName |
+              ros::init_options::NoRosout);
+
+    // The console is our parent; stop when it's gone.
+    const pid_t console = getppid();
+    ros::Subscriber rosout_sub;
+    bool is_connected = false;
+    while (getppid() == console) {
+      bool master_status = ros::master::check();
+
+      if (!is_connected && master_status) {
+        ros::start();
+        ros::NodeHandle nh;
+        rosout_sub = nh.subscribe<RosoutMessage>("/rosout_agg", 10000, relayMessage);
+        is_connected = true;
+      } else if (is_connected && !master_status) {
+        rosout_sub = ros::Subscriber();
+        ros::shutdown();
+        is_connected = false;
+      } else if (is_connected && master_status) {
+        ros::spinOnce();
+        if (!relay_output.empty()) {
+          if (fwrite(&relay_output[0], 1, relay_output.size(), output) != relay_output.size() ||
+              fflush(output) != 0) {
+            break;
+          }
+          relay_output.clear();
+        }
+      }
+      usleep(50000);
+    }
+
+    rosout_sub = ros::Subscriber();
+    if (ros::isStarted()) {
+      ros::shutdown();
+    }
+    return 0;
+  }
+
+  void MasterSource::start()
+  {
+    stop();
+
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert("ROS_MASTER_URI", master_uri_);
+
+    relay_ = new QProcess(this);
+    relay_->setProcessEnvironment(environment);
+    relay_->setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    QObject::connect(relay_, SIGNAL(readyReadStandardOutput()),
+                     this, SLOT(readMessages()));
+    QObject::connect(relay_, SIGNAL(error(QProcess::ProcessError)),
+                     this, SLOT(handleError(QProcess::ProcessError)));
+    relay_->start(QCoreApplication::applicationFilePath(),
+                  QStringList() << RELAY_ARGUMENT);
+  }
+
+  void MasterSource::stop()
+  {
+    restart_timer_->stop();
+    if (relay_ == NULL) {
+      return;
+    }
+
+    relay_->disconnect(this);
+    relay_->terminate();
+    if (!relay_->waitForFinished(1000)) {
+      relay_->kill();
+      relay_->waitForFinished(1000);
+    }
+    delete relay_;
+    relay_ = NULL;
+    buffer_.clear();
+  }
+
+  void MasterSource::readMessages()
+  {
+    buffer_.append(relay_->readAllStandardOutput());
+
+    RosoutMessageList msgs;
+    int offset = 0;
+    while (true) {
+      uint32_t length = 0;
+      if (buffer_.size() - offset < static_cast<int>(sizeof(length))) {
+        break;
+      }
+      std::memcpy(&length, buffer_.constData() + offset, sizeof(length));
+      if (static_cast<qint64>(buffer_.size() - offset - sizeof(length)) < length) {
+        break;
+      }
+
+      RosoutMessagePtr msg = boost::make_shared<RosoutMessage>();
+      ros::serialization::IStream stream(
+        reinterpret_cast<uint8_t*>(buffer_.data() + offset + sizeof(length)), length);
+      ros::serialization::deserialize(stream, *msg);
+      msgs.push_back(msg);
+      offset += sizeof(length) + length;
+    }
+    buffer_.remove(0, offset);
+
+    if (!msgs.empty()) {
+      // The relay is working, so the next crash starts a fresh backoff.
+      restart_delay_ms_ = MIN_RESTART_DELAY_MS;
+      emit logsReceived(source_id_, msgs);
+    }
+  }
+
+  void MasterSource::handleError(QProcess::ProcessError error)
+  {
+    qWarning("Relay for ROS master %s failed: %s",
+             master_uri_.toStdString().c_str(),
+             relay_->errorString().toStdString().c_str());
+
+    // The relay is restarted from the timer rather than from here, since
+    // restarting deletes the QProcess that is emitting this signal.
+    if (error == QProcess::Crashed && !restart_timer_->isActive()) {
+      qWarning("Restarting relay for ROS master %s in %d ms",
+               master_uri_.toStdString().c_str(), restart_delay_ms_);
+      restart_timer_->start(restart_delay_ms_);
+      restart_delay_ms_ = std::min(restart_delay_ms_ * 2, MAX_RESTART_DELAY_MS);
+    }
+  }
+}
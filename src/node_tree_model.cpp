@@ -0,0 +1,352 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#include <algorithm>
+#include <vector>
+
+#include <swri_console/node_tree_model.h>
+#include <swri_console/log_database.h>
+
+#include <QStringList>
+
+namespace swri_console
+{
+struct NodeTreeModel::Item
+{
+  // The last segment of the name, e.g. "camera" for "/robot/camera".
+  std::string segment;
+  // The full name up to and including this segment, followed by a
+  // '/'.  Every node beneath this item starts with this prefix.
+  std::string prefix;
+  // The id of the node with this exact name, or -1 if the item is
+  // only a namespace.
+  int64_t node_id;
+
+  Item *parent;
+  int row;
+  // Sorted by segment.
+  std::vector<Item*> children;
+
+  // Messages from this node and all nodes beneath it.
+  MessageCounts counts;
+
+  Item() : node_id(-1), parent(NULL), row(0) {}
+
+  ~Item()
+  {
+    for (size_t i = 0; i < children.size(); i++) {
+      delete children[i];
+    }
+  }
+};
+
+// Splits a ROS name into its namespace segments, recording where each
+// segment ends in the original string.
+static void splitName(const std::string &name,
+                      std::vector<std::string> *segments,
+                      std::vector<size_t> *ends)
+{
+  size_t start = 0;
+  while (start <= name.size()) {
+    size_t end = name.find('/', start);
+    if (end == std::string::npos) {
+      end = name.size();
+    }
+    if (end > start) {
+      segments->push_back(name.substr(start, end - start));
+      ends->push_back(end);
+    }
+    start = end + 1;
+  }
+
+  if (segments->empty()) {
+    segments->push_back(name);
+    ends->push_back(name.size());
+  }
+}
+
+NodeTreeModel::NodeTreeModel(LogDatabase *db)
+  :
+  db_(db),
+  root_(new Item())
+{
+  QObject::connect(db_, SIGNAL(databaseCleared()),
+                   this, SLOT(handleDatabaseCleared()));
+  QObject::connect(db_, SIGNAL(messagesAdded()),
+                   this, SLOT(handleMessagesAdded()));
+
+  // Count deltas only cover new messages, so a window that is opened
+  // after messages have arrived has to pick up the existing nodes.
+  for (size_t id = 0; id < db_->nodeCount(); id++) {
+    if (db_->messageCount(id)) {
+      addNode(id);
+      addCounts(node_items_[id], db_->messageCounts(id));
+    }
+  }
+}
+
+NodeTreeModel::~NodeTreeModel()
+{
+  delete root_;
+}
+
+NodeTreeModel::Item* NodeTreeModel::itemFromIndex(const QModelIndex &index) const
+{
+  if (!index.isValid()) {
+    return root_;
+  }
+  return static_cast<Item*>(index.internalPointer());
+}
+
+QModelIndex NodeTreeModel::indexFromItem(Item *item) const
+{
+  if (item == root_) {
+    return QModelIndex();
+  }
+  return createIndex(item->row, 0, item);
+}
+
+QModelIndex NodeTreeModel::index(int row, int column,
+                                 const QModelIndex &parent) const
+{
+  Item *parent_item = itemFromIndex(parent);
+  if (column != 0 || row < 0 ||
+      static_cast<size_t>(row) >= parent_item->children.size()) {
+    return QModelIndex();
+  }
+  return createIndex(row, 0, parent_item->children[row]);
+}
+
+QModelIndex NodeTreeModel::parent(const QModelIndex &index) const
+{
+  if (!index.isValid()) {
+    return QModelIndex();
+  }
+  return indexFromItem(itemFromIndex(index)->parent);
+}
+
+int NodeTreeModel::rowCount(const QModelIndex &parent) const
+{
+  if (parent.column() > 0) {
+    return 0;
+  }
+  return itemFromIndex(parent)->children.size();
+}
+
+int NodeTreeModel::columnCount(const QModelIndex &) const
+{
+  return 1;
+}
+
+void NodeTreeModel::addToFilter(const QModelIndex &index,
+                                std::set<std::string> *names,
+                                std::set<std::string> *prefixes) const
+{
+  if (!index.isValid()) {
+    return;
+  }
+
+  const Item *item = itemFromIndex(index);
+  if (item->node_id >= 0) {
+    names->insert(db_->nodeName(item->node_id));
+  }
+  if (!item->children.empty()) {
+    prefixes->insert(item->prefix);
+  }
+}
+
+QString NodeTreeModel::shortName(const QModelIndex &index) const
+{
+  if (!index.isValid()) {
+    return QString();
+  }
+
+  const Item *item = itemFromIndex(index);
+  QString name = QString::fromStdString(item->segment);
+  if (!item->children.empty()) {
+    name += "/";
+  }
+  return name;
+}
+
+QVariant NodeTreeModel::data(const QModelIndex &index, int role) const
+{
+  if (!index.isValid()) {
+    return QVariant();
+  } 
+
+  const Item *item = itemFromIndex(index);
+  const MessageCounts &counts = item->counts;
+  
+  if (role == Qt::DisplayRole) {
+    // Warnings and worse are called out separately so that problem
+    // areas stand out even when the tree is collapsed.
+    QString text = QString("%1 (%2")
+      .arg(shortName(index))
+      .arg(static_cast<qulonglong>(counts.total));
+    const char *labels[SEVERITY_LEVELS] = { "D", "I", "W", "E", "F" };
+    for (int i = 2; i < SEVERITY_LEVELS; i++) {
+      if (counts.severity[i]) {
+        text += QString(", %1 %2")
+          .arg(static_cast<qulonglong>(counts.severity[i]))
+          .arg(labels[i]);
+      }
+    }
+    text += ")";
+    return QVariant(text);
+  } else if (role == Qt::ToolTipRole) {
+    QString name = item->node_id >= 0 ?
+      QString::fromStdString(db_->nodeName(item->node_id)) :
+      QString::fromStdString(item->prefix);
+    return QVariant(QString("%1\n"
+                            "Debug: %2\n"
+                            "Info: %3\n"
+                            "Warn: %4\n"
+                            "Error: %5\n"
+                            "Fatal: %6")
+                    .arg(name)
+                    .arg(static_cast<qulonglong>(counts.severity[0]))
+                    .arg(static_cast<qulonglong>(counts.severity[1]))
+                    .arg(static_cast<qulonglong>(counts.severity[2]))
+                    .arg(static_cast<qulonglong>(counts.severity[3]))
+                    .arg(static_cast<qulonglong>(counts.severity[4])));
+  }
+
+  return QVariant();
+}
+
+void NodeTreeModel::clear()
+{
+  beginResetModel();
+  delete root_;
+  root_ = new Item();
+  node_items_.clear();
+  endResetModel();
+}
+
+void NodeTreeModel::handleDatabaseCleared()
+{
+  // When the database is cleared, we reset all of the counts to zero
+  // instead of deleting the nodes from the tree.  This allows a user
+  // to clear out the logs while retaining their node selection so
+  // that they can easily reset the data without having to choose the
+  // selection again.
+  clearCounts(root_);
+}
+
+void NodeTreeModel::clearCounts(Item *item)
+{
+  item->counts.clear();
+  for (size_t i = 0; i < item->children.size(); i++) {
+    clearCounts(item->children[i]);
+  }
+
+  if (!item->children.empty()) {
+    Q_EMIT dataChanged(indexFromItem(item->children.front()),
+                       indexFromItem(item->children.back()));
+  }
+}
+
+void NodeTreeModel::handleMessagesAdded()
+{
+  // Only the nodes that received messages in this batch, and the
+  // namespaces above them, need to be updated.
+  const std::vector<NodeCountDelta> &deltas = db_->countDeltas();
+  for (size_t i = 0; i < deltas.size(); i++) {
+    const uint32_t node_id = deltas[i].node_id;
+    if (node_id >= node_items_.size() || node_items_[node_id] == NULL) {
+      addNode(node_id);
+    }
+    addCounts(node_items_[node_id], deltas[i].counts);
+  }
+}
+
+void NodeTreeModel::addCounts(Item *item, const MessageCounts &counts)
+{
+  for (; item != root_; item = item->parent) {
+    item->counts.add(counts);
+    QModelIndex index = indexFromItem(item);
+    Q_EMIT dataChanged(index, index);
+  }
+}
+
+bool NodeTreeModel::segmentLess(const Item *item, const std::string &segment)
+{
+  return item->segment < segment;
+}
+
+void NodeTreeModel::addNode(uint32_t node_id)
+{
+  if (node_id >= node_items_.size()) {
+    node_items_.resize(db_->nodeCount(), NULL);
+  }
+
+  const std::string &name = db_->nodeName(node_id);
+  std::vector<std::string> segments;
+  std::vector<size_t> ends;
+  splitName(name, &segments, &ends);
+
+  Item *parent = root_;
+  for (size_t i = 0; i < segments.size(); i++) {
+    std::vector<Item*>::iterator it = std::lower_bound(
+      parent->children.begin(), parent->children.end(),
+      segments[i], segmentLess);
+
+    if (it == parent->children.end() || (*it)->segment != segments[i]) {
+      int row = it - parent->children.begin();
+
+      Item *item = new Item();
+      item->segment = segments[i];
+      item->prefix = name.substr(0, ends[i]) + "/";
+      item->parent = parent;
+      item->row = row;
+
+      beginInsertRows(indexFromItem(parent), row, row);
+      it = parent->children.insert(it, item);
+      for (size_t j = row + 1; j < parent->children.size(); j++) {
+        parent->children[j]->row = j;
+      }
+      endInsertRows();
+
+      if (parent != root_ && parent->children.size() == 1) {
+        // The parent just became a namespace, which changes how it is
+        // displayed.
+        QModelIndex index = indexFromItem(parent);
+        Q_EMIT dataChanged(index, index);
+      }
+    }
+
+    parent = *it;
+  }
+
+  parent->node_id = node_id;
+  node_items_[node_id] = parent;
+}
+}  // namespace swri_console
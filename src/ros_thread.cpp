@@ -35,7 +35,8 @@ using namespace swri_console;
 
 RosThread::RosThread(int argc, char** argv) :
   is_connected_(false),
-  is_running_(true)
+  is_running_(true),
+  subscribe_rosout_(false)
 {
   ros::init(argc, argv, "swri_console",
             ros::init_options::AnonymousName |
@@ -53,7 +54,17 @@ void RosThread::run()
     } else if (is_connected_ && !master_status) {
       stopRos();
     } else if (is_connected_ && master_status) {
+      updateRosoutSubscription();
       ros::spinOnce();
+      if (!received_.empty()) {
+        Q_EMIT logsReceived(received_);
+        received_.clear();
+      }
+      if (direct_rosout_sub_ && ros::WallTime::now() - statistics_time_ > ros::WallDuration(1.0)) {
+        statistics_time_ = ros::WallTime::now();
+        deduplicator_.expire();
+        Q_EMIT pathStatistics(deduplicator_.statistics());
+      }
       Q_EMIT spun();
     }
     msleep(50);
@@ -77,20 +88,55 @@ void RosThread::startRos()
   is_connected_ = true;
 
   ros::NodeHandle nh;
-  rosout_sub_ = nh.subscribe("/rosout_agg", 10000,
-                             &RosThread::handleRosout,
-                             this);
+  // Subscribing with RosoutMessage instead of rosgraph_msgs::Log
+  // avoids decoding the parts of the message we don't use.
+  rosout_sub_ = nh.subscribe<RosoutMessage>("/rosout_agg", 10000,
+                                            &RosThread::handleRosout,
+                                            this);
   Q_EMIT connected(true);
 }
 
+void RosThread::setSubscribeRosout(bool subscribe)
+{
+  subscribe_rosout_ = subscribe;
+}
+
+void RosThread::updateRosoutSubscription()
+{
+  if (subscribe_rosout_ == static_cast<bool>(direct_rosout_sub_)) {
+    return;
+  }
+
+  deduplicator_.clear();
+  if (subscribe_rosout_) {
+    ros::NodeHandle nh;
+    direct_rosout_sub_ = nh.subscribe<RosoutMessage>("/rosout", 10000,
+                                                     &RosThread::handleDirectRosout,
+                                                     this);
+    statistics_time_ = ros::WallTime::now();
+  } else {
+    direct_rosout_sub_.shutdown();
+  }
+}
+
 void RosThread::stopRos()
 {
+  direct_rosout_sub_.shutdown();
   ros::shutdown();
   is_connected_ = false;
   Q_EMIT connected(false);
 }
 
-void RosThread::handleRosout(const rosgraph_msgs::LogConstPtr &msg)
+void RosThread::handleRosout(const RosoutMessageConstPtr &msg)
 {
-  Q_EMIT logReceived(msg);
+  if (!direct_rosout_sub_ || deduplicator_.add(*msg, ROSOUT_AGGREGATED)) {
+    received_.push_back(msg);
+  }
+}
+
+void RosThread::handleDirectRosout(const RosoutMessageConstPtr &msg)
+{
+  if (deduplicator_.add(*msg, ROSOUT_DIRECT)) {
+    received_.push_back(msg);
+  }
 }
@@ -0,0 +1,123 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#include <boost/functional/hash.hpp>
+
+#include <swri_console/rosout_deduplicator.h>
+
+namespace swri_console
+{
+  // How long a message is remembered after its first copy arrives.
+  // The copy over the slower path has to arrive within this time to be
+  // recognized; after that it is counted as lost.
+  static const double LOSS_TIMEOUT = 5.0;
+
+  // The most messages remembered, whatever their age.  This only bounds
+  // memory; messages forgotten because of it aren't counted as lost.
+  static const size_t WINDOW_SIZE = 100000;
+
+  RosoutDeduplicator::RosoutDeduplicator()
+  {
+  }
+
+  bool RosoutDeduplicator::add(const RosoutMessage& msg, RosoutPath path)
+  {
+    const ros::WallTime now = ros::WallTime::now();
+    expire(now);
+
+    statistics_.received[path]++;
+
+    size_t key = 0;
+    boost::hash_combine(key, msg.name);
+    boost::hash_combine(key, msg.header.stamp.sec);
+    boost::hash_combine(key, msg.header.stamp.nsec);
+    boost::hash_combine(key, msg.msg);
+
+    const uint8_t mask = 1 << path;
+    boost::unordered_map<size_t, uint8_t>::iterator it = paths_.find(key);
+    if (it != paths_.end()) {
+      if (it->second & mask) {
+        // The node logged the same text twice with the same timestamp,
+        // so this is a new message rather than a copy.
+        statistics_.first[path]++;
+        return true;
+      }
+      it->second |= mask;
+      return false;
+    }
+
+    paths_[key] = mask;
+    Arrival arrival;
+    arrival.key = key;
+    arrival.time = now;
+    order_.push_back(arrival);
+    statistics_.first[path]++;
+    if (order_.size() > WINDOW_SIZE) {
+      forgetOldest(false);
+    }
+    return true;
+  }
+
+  void RosoutDeduplicator::expire()
+  {
+    expire(ros::WallTime::now());
+  }
+
+  void RosoutDeduplicator::expire(const ros::WallTime& now)
+  {
+    const ros::WallDuration timeout(LOSS_TIMEOUT);
+    while (!order_.empty() && now - order_.front().time > timeout) {
+      forgetOldest(true);
+    }
+  }
+
+  void RosoutDeduplicator::clear()
+  {
+    paths_.clear();
+    order_.clear();
+    statistics_ = RosoutPathStatistics();
+  }
+
+  void RosoutDeduplicator::forgetOldest(bool count_lost)
+  {
+    boost::unordered_map<size_t, uint8_t>::iterator it = paths_.find(order_.front().key);
+    order_.pop_front();
+    if (it == paths_.end()) {
+      return;
+    }
+
+    for (int i = 0; count_lost && i < ROSOUT_PATH_COUNT; i++) {
+      if ((it->second & (1 << i)) == 0) {
+        statistics_.lost[i]++;
+      }
+    }
+    paths_.erase(it);
+  }
+}
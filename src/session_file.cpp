@@ -0,0 +1,297 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#include <algorithm>
+#include <cstring>
+
+#include <swri_console/column_file.h>
+#include <swri_console/session_file.h>
+
+namespace swri_console
+{
+namespace
+{
+const char SESSION_MAGIC[8] = { 'S', 'W', 'C', 'S', 'E', 'S', '\0', '\0' };
+const uint32_t SESSION_VERSION = 1;
+
+struct SessionHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t rows;
+  // The arena starts right after the header.
+  uint64_t arena_size;
+  // Offset of the string tables, which are followed by the columns.
+  uint64_t strings_offset;
+  uint64_t columns_offset;
+};
+
+// Bytes per row, summed over all columns.
+const size_t ROW_SIZE = 3 * sizeof(uint64_t) + 9 * sizeof(uint32_t) + sizeof(uint8_t);
+}  // namespace
+
+SessionWriter::SessionWriter(const QString &filename)
+  :
+  file_(filename),
+  ok_(false),
+  arena_size_(0)
+{
+}
+
+bool SessionWriter::open()
+{
+  ok_ = file_.open(QIODevice::WriteOnly);
+  if (ok_) {
+    // The header is rewritten with the real offsets by finish().
+    SessionHeader header;
+    std::memset(&header, 0, sizeof(header));
+    ok_ = file_.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header);
+  }
+  return ok_;
+}
+
+void SessionWriter::add(const LogEntry &entry,
+                        const std::string &node,
+                        const std::string &file,
+                        const std::string &function,
+                        const QByteArray &template_key,
+                        uint32_t repeat_count,
+                        const ros::Time &last_stamp,
+                        const QStringList &text)
+{
+  if (!ok_) {
+    return;
+  }
+
+  const QByteArray body = text.join("\n").toUtf8();
+  ok_ = file_.write(body) == body.size();
+
+  stamps_.push_back(entry.stamp.toNSec());
+  last_stamps_.push_back(last_stamp.toNSec());
+  body_offsets_.push_back(arena_size_);
+  seqs_.push_back(entry.seq);
+  lines_.push_back(entry.line);
+  node_ids_.push_back(nodes_.intern(node));
+  file_ids_.push_back(files_.intern(file));
+  function_ids_.push_back(functions_.intern(function));
+  template_ids_.push_back(templates_.intern(std::string(template_key.constData(), template_key.size())));
+  // Derived from the body rather than taken from the entry, so that
+  // the two always agree when the file is loaded.
+  line_counts_.push_back(body.count('\n') + 1);
+  repeat_counts_.push_back(repeat_count);
+  body_lengths_.push_back(body.size());
+  levels_.push_back(entry.level);
+
+  arena_size_ += body.size();
+}
+
+bool SessionWriter::finish()
+{
+  if (!ok_) {
+    file_.cancelWriting();
+    return false;
+  }
+
+  const uint64_t strings_offset = sizeof(SessionHeader) + arena_size_;
+  QByteArray strings;
+  appendStringTable(&strings, nodes_);
+  appendStringTable(&strings, files_);
+  appendStringTable(&strings, functions_);
+  appendStringTable(&strings, templates_);
+  padToAlignment(&strings, strings_offset);
+
+  SessionHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, SESSION_MAGIC, sizeof(header.magic));
+  header.version = SESSION_VERSION;
+  header.rows = stamps_.size();
+  header.arena_size = arena_size_;
+  header.strings_offset = strings_offset;
+  header.columns_offset = strings_offset + strings.size();
+
+  bool ok = (file_.write(strings) == strings.size() &&
+             writeColumn(&file_, stamps_) &&
+             writeColumn(&file_, last_stamps_) &&
+             writeColumn(&file_, body_offsets_) &&
+             writeColumn(&file_, seqs_) &&
+             writeColumn(&file_, lines_) &&
+             writeColumn(&file_, node_ids_) &&
+             writeColumn(&file_, file_ids_) &&
+             writeColumn(&file_, function_ids_) &&
+             writeColumn(&file_, template_ids_) &&
+             writeColumn(&file_, line_counts_) &&
+             writeColumn(&file_, repeat_counts_) &&
+             writeColumn(&file_, body_lengths_) &&
+             writeColumn(&file_, levels_) &&
+             file_.seek(0) &&
+             file_.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header));
+  if (!ok) {
+    file_.cancelWriting();
+    return false;
+  }
+  return file_.commit();
+}
+
+SessionFile::SessionFile(const QString &filename)
+  :
+  file_(filename),
+  data_(NULL),
+  size_(0),
+  rows_(0),
+  arena_offset_(0),
+  arena_size_(0)
+{
+}
+
+QSharedPointer<SessionFile> SessionFile::open(const QString &filename)
+{
+  QSharedPointer<SessionFile> session(new SessionFile(filename));
+  if (!session->load()) {
+    return QSharedPointer<SessionFile>();
+  }
+  return session;
+}
+
+bool SessionFile::load()
+{
+  if (!file_.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+
+  size_ = file_.size();
+  if (size_ < sizeof(SessionHeader)) {
+    return false;
+  }
+  data_ = file_.map(0, size_);
+  if (!data_) {
+    return false;
+  }
+
+  SessionHeader header;
+  std::memcpy(&header, data_, sizeof(header));
+  if (std::memcmp(header.magic, SESSION_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != SESSION_VERSION) {
+    return false;
+  }
+
+  arena_offset_ = sizeof(SessionHeader);
+  arena_size_ = header.arena_size;
+  if (header.strings_offset > size_ ||
+      header.strings_offset < arena_offset_ ||
+      header.arena_size > header.strings_offset - arena_offset_) {
+    return false;
+  }
+
+  std::vector<std::string> templates;
+  size_t offset = header.strings_offset;
+  if (!readStringTable(data_, size_, &offset, &nodes_) ||
+      !readStringTable(data_, size_, &offset, &files_) ||
+      !readStringTable(data_, size_, &offset, &functions_) ||
+      !readStringTable(data_, size_, &offset, &templates)) {
+    return false;
+  }
+  for (size_t i = 0; i < templates.size(); i++) {
+    templates_.push_back(QByteArray(templates[i].data(), templates[i].size()));
+  }
+
+  // The row count is checked by division so that a corrupt count
+  // can't overflow past the size check.
+  if (header.columns_offset < offset ||
+      header.columns_offset % sizeof(uint64_t) != 0 ||
+      header.columns_offset > size_ ||
+      header.rows > (size_ - header.columns_offset) / ROW_SIZE) {
+    return false;
+  }
+  rows_ = header.rows;
+
+  offset = header.columns_offset;
+  stamps_ = mapColumn<uint64_t>(data_, &offset, rows_);
+  last_stamps_ = mapColumn<uint64_t>(data_, &offset, rows_);
+  body_offsets_ = mapColumn<uint64_t>(data_, &offset, rows_);
+  seqs_ = mapColumn<uint32_t>(data_, &offset, rows_);
+  lines_ = mapColumn<uint32_t>(data_, &offset, rows_);
+  node_ids_ = mapColumn<uint32_t>(data_, &offset, rows_);
+  file_ids_ = mapColumn<uint32_t>(data_, &offset, rows_);
+  function_ids_ = mapColumn<uint32_t>(data_, &offset, rows_);
+  template_ids_ = mapColumn<uint32_t>(data_, &offset, rows_);
+  line_counts_ = mapColumn<uint32_t>(data_, &offset, rows_);
+  repeat_counts_ = mapColumn<uint32_t>(data_, &offset, rows_);
+  body_lengths_ = mapColumn<uint32_t>(data_, &offset, rows_);
+  levels_ = mapColumn<uint8_t>(data_, &offset, rows_);
+
+  // Offsets are checked without adding to them, so that a corrupt one
+  // can't wrap around.  The line count decides how many rows an entry
+  // gets in the display, so it has to match the body.
+  const char *arena = reinterpret_cast<const char*>(data_ + arena_offset_);
+  for (size_t i = 0; i < rows_; i++) {
+    if (body_offsets_[i] > arena_size_ ||
+        body_lengths_[i] > arena_size_ - body_offsets_[i]) {
+      return false;
+    }
+    const char *body = arena + body_offsets_[i];
+    const size_t lines = std::count(body, body + body_lengths_[i], '\n') + 1;
+    if (line_counts_[i] == 0 || line_counts_[i] != lines) {
+      return false;
+    }
+  }
+
+  return (columnIdsValid(node_ids_, rows_, nodes_) &&
+          columnIdsValid(file_ids_, rows_, files_) &&
+          columnIdsValid(function_ids_, rows_, functions_) &&
+          columnIdsValid(template_ids_, rows_, templates_));
+}
+
+void SessionFile::message(size_t row, IndexedMessage *msg) const
+{
+  msg->stamp.fromNSec(stamps_[row]);
+  msg->level = levels_[row];
+  msg->seq = seqs_[row];
+  msg->node = nodes_[node_ids_[row]];
+  msg->file = files_[file_ids_[row]];
+  msg->function = functions_[function_ids_[row]];
+  msg->line = lines_[row];
+  msg->line_count = line_counts_[row];
+  msg->template_key = templates_[template_ids_[row]];
+  msg->repeat_count = repeat_counts_[row];
+  msg->last_stamp.fromNSec(last_stamps_[row]);
+  msg->body_locator = row;
+}
+
+QStringList SessionFile::text(uint64_t locator)
+{
+  if (locator >= rows_) {
+    return QStringList();
+  }
+
+  const char *body = reinterpret_cast<const char*>(data_ + arena_offset_ + body_offsets_[locator]);
+  return QString::fromUtf8(body, body_lengths_[locator]).split('\n');
+}
+}  // namespace swri_console
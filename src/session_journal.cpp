@@ -0,0 +1,289 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#include <unistd.h>
+
+#include <cstring>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#include <boost/make_shared.hpp>
+#include <ros/serialization.h>
+
+#include <swri_console/session_journal.h>
+
+using namespace swri_console;
+
+// Queued messages are written at least this often...
+static const unsigned long GROUP_COMMIT_MS = 100;
+// ...or as soon as this many are waiting.
+static const size_t GROUP_COMMIT_SIZE = 1000;
+
+static const uint32_t FRAME_MAGIC = 0x4a435753;  // "SWCJ"
+
+struct FrameHeader
+{
+  uint32_t magic;
+  uint32_t length;
+  uint16_t checksum;
+  uint16_t reserved;
+  uint32_t count;
+};
+
+SessionJournal::SessionJournal() :
+  stopping_(false),
+  reset_requested_(false)
+{
+}
+
+SessionJournal::~SessionJournal()
+{
+  close();
+}
+
+QString SessionJournal::journalPath()
+{
+  return QDir::home().filePath(".swri_console/journal");
+}
+
+QString SessionJournal::previousJournalPath()
+{
+  return QDir::home().filePath(".swri_console/journal.previous");
+}
+
+bool SessionJournal::open(const QString& filename)
+{
+  close();
+
+  QDir().mkpath(QFileInfo(filename).absolutePath());
+  file_.setFileName(filename);
+  if (!file_.open(QIODevice::WriteOnly | QIODevice::Append)) {
+    return false;
+  }
+
+  stopping_ = false;
+  start();
+  return true;
+}
+
+void SessionJournal::close()
+{
+  if (!isRunning()) {
+    return;
+  }
+
+  {
+    QMutexLocker lock(&mutex_);
+    stopping_ = true;
+    wake_.wakeOne();
+  }
+  wait();
+  file_.close();
+}
+
+void SessionJournal::append(const RosoutMessageList& msgs)
+{
+  QMutexLocker lock(&mutex_);
+  if (!isRunning()) {
+    return;
+  }
+  pending_.insert(pending_.end(), msgs.begin(), msgs.end());
+  if (pending_.size() >= GROUP_COMMIT_SIZE) {
+    wake_.wakeOne();
+  }
+}
+
+void SessionJournal::append(const MessageList& msgs)
+{
+  RosoutMessageList converted;
+  converted.reserve(msgs.size());
+  for (size_t i = 0; i < msgs.size(); i++) {
+    RosoutMessagePtr msg = boost::make_shared<RosoutMessage>();
+    msg->header.seq = msgs[i]->header.seq;
+    msg->header.stamp = msgs[i]->header.stamp;
+    msg->level = msgs[i]->level;
+    msg->name = msgs[i]->name;
+    msg->msg = msgs[i]->msg;
+    msg->file = msgs[i]->file;
+    msg->function = msgs[i]->function;
+    msg->line = msgs[i]->line;
+    converted.push_back(msg);
+  }
+  append(converted);
+}
+
+void SessionJournal::setSourceName(int source_id, const std::string& name)
+{
+  QMutexLocker lock(&mutex_);
+  if (source_names_.size() <= static_cast<size_t>(source_id)) {
+    source_names_.resize(source_id + 1);
+  }
+  source_names_[source_id] = name;
+}
+
+void SessionJournal::append(int source_id, const RosoutMessageList& msgs)
+{
+  std::string source_name;
+  {
+    QMutexLocker lock(&mutex_);
+    if (!isRunning()) {
+      return;
+    }
+    if (static_cast<size_t>(source_id) < source_names_.size()) {
+      source_name = source_names_[source_id];
+    }
+  }
+  if (source_name.empty()) {
+    append(msgs);
+    return;
+  }
+
+  RosoutMessageList renamed;
+  renamed.reserve(msgs.size());
+  for (size_t i = 0; i < msgs.size(); i++) {
+    RosoutMessagePtr msg = boost::make_shared<RosoutMessage>(*msgs[i]);
+    msg->name = sourceNodeName(source_name, msg->name);
+    renamed.push_back(msg);
+  }
+  append(renamed);
+}
+
+void SessionJournal::reset()
+{
+  QMutexLocker lock(&mutex_);
+  pending_.clear();
+  reset_requested_ = true;
+  wake_.wakeOne();
+}
+
+void SessionJournal::run()
+{
+  bool stopping = false;
+  while (!stopping) {
+    RosoutMessageList msgs;
+    bool reset = false;
+    {
+      QMutexLocker lock(&mutex_);
+      if (!stopping_ && !reset_requested_ && pending_.size() < GROUP_COMMIT_SIZE) {
+        wake_.wait(&mutex_, GROUP_COMMIT_MS);
+      }
+      msgs.swap(pending_);
+      reset = reset_requested_;
+      reset_requested_ = false;
+      stopping = stopping_;
+    }
+
+    if (reset) {
+      file_.resize(0);
+    }
+    if (!msgs.empty() && !writeFrame(msgs)) {
+      qWarning("Failed to write to session journal %s",
+               file_.fileName().toStdString().c_str());
+    }
+  }
+}
+
+bool SessionJournal::writeFrame(const RosoutMessageList& msgs)
+{
+  QByteArray payload;
+  for (size_t i = 0; i < msgs.size(); i++) {
+    const uint32_t length = ros::serialization::serializationLength(*msgs[i]);
+    const int offset = payload.size();
+    payload.resize(offset + sizeof(length) + length);
+    std::memcpy(payload.data() + offset, &length, sizeof(length));
+
+    ros::serialization::OStream stream(
+      reinterpret_cast<uint8_t*>(payload.data() + offset + sizeof(length)), length);
+    ros::serialization::serialize(stream, *msgs[i]);
+  }
+
+  FrameHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.magic = FRAME_MAGIC;
+  header.length = payload.size();
+  header.checksum = qChecksum(payload.constData(), payload.size());
+  header.count = msgs.size();
+
+  if (file_.write(reinterpret_cast<const char*>(&header), sizeof(header)) != sizeof(header) ||
+      file_.write(payload) != payload.size() ||
+      !file_.flush()) {
+    return false;
+  }
+
+  // Make sure the frame survives a power loss, not just a crash.
+  return fdatasync(file_.handle()) == 0;
+}
+
+bool SessionJournal::recover(const QString& filename, MessageList* msgs)
+{
+  QFile file(filename);
+  if (!file.open(QIODevice::ReadOnly)) {
+    return false;
+  }
+
+  while (true) {
+    FrameHeader header;
+    if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header) ||
+        header.magic != FRAME_MAGIC) {
+      break;
+    }
+
+    QByteArray payload = file.read(header.length);
+    if (payload.size() != static_cast<int>(header.length) ||
+        qChecksum(payload.constData(), payload.size()) != header.checksum) {
+      // The console died while writing this frame.
+      break;
+    }
+
+    size_t offset = 0;
+    for (uint32_t i = 0; i < header.count; i++) {
+      uint32_t length = 0;
+      if (offset + sizeof(length) > header.length) {
+        break;
+      }
+      std::memcpy(&length, payload.constData() + offset, sizeof(length));
+      offset += sizeof(length);
+      if (offset + length > header.length) {
+        break;
+      }
+
+      rosgraph_msgs::LogPtr msg(new rosgraph_msgs::Log());
+      ros::serialization::IStream stream(
+        reinterpret_cast<uint8_t*>(payload.data() + offset), length);
+      ros::serialization::deserialize(stream, *msg);
+      msgs->push_back(msg);
+      offset += length;
+    }
+  }
+
+  return true;
+}
@@ -51,4 +51,11 @@ namespace swri_console
   const QString SettingsKeys::FATAL_COLOR = "Colors/FatalColor";
   const QString SettingsKeys::COLORIZE_LOGS = "Colors/ColorizeLogs";
   const QString SettingsKeys::ALTERNATE_LOG_ROW_COLORS = "Logs/AlternateRowColors";
+  const QString SettingsKeys::COLLAPSE_REPEATS = "Logs/CollapseRepeats";
+  const QString SettingsKeys::BODY_CACHE_SIZE = "Logs/BodyCacheSize";
+  const QString SettingsKeys::JOURNAL_SESSION = "Logs/JournalSession";
+  const QString SettingsKeys::SUBSCRIBE_ROSOUT = "Logs/SubscribeRosout";
+  const QString SettingsKeys::RATE_LIMIT = "Logs/RateLimit";
+  const QString SettingsKeys::MEMORY_BUDGET = "Logs/MemoryBudget";
+  const QString SettingsKeys::SPILL_BUDGET = "Logs/SpillBudget";
 }
@@ -28,17 +28,15 @@
 //
 // *****************************************************************************
 
-#include <stdio.h>
-#include <vector>
-
-#include <swri_console/node_list_model.h>
+#include <swri_console/template_list_model.h>
 #include <swri_console/log_database.h>
 
 namespace swri_console
 {
-NodeListModel::NodeListModel(LogDatabase *db)
+TemplateListModel::TemplateListModel(LogDatabase *db)
   :
-  db_(db)
+  db_(db),
+  row_count_(db->templateCount())
 {
   QObject::connect(db_, SIGNAL(databaseCleared()),
                    this, SLOT(handleDatabaseCleared()));
@@ -46,92 +44,69 @@ NodeListModel::NodeListModel(LogDatabase *db)
                    this, SLOT(handleMessagesAdded()));
 }
 
-NodeListModel::~NodeListModel()
+TemplateListModel::~TemplateListModel()
 {
 }
 
-int NodeListModel::rowCount(const QModelIndex &parent) const
+int TemplateListModel::rowCount(const QModelIndex &parent) const
 {
-  return ordering_.size();
+  if (parent.isValid()) {
+    return 0;
+  }
+
+  return row_count_;
 }
 
-std::string NodeListModel::nodeName(const QModelIndex &index) const
+uint32_t TemplateListModel::templateId(const QModelIndex &index) const
 {
-  if (index.parent().isValid() ||
-      static_cast<size_t>(index.row()) > ordering_.size()) {
-    return "";
-  }
-
-  return ordering_[index.row()];
+  return index.row();
 }
 
-QVariant NodeListModel::data(const QModelIndex &index, int role) const
+QVariant TemplateListModel::data(const QModelIndex &index, int role) const
 {
   if (index.parent().isValid() ||
-      static_cast<size_t>(index.row()) > ordering_.size()) {
+      static_cast<size_t>(index.row()) >= row_count_) {
     return QVariant();
-  } 
+  }
+
+  const LogTemplate &log_template = db_->logTemplate(index.row());
 
-  std::string name = ordering_[index.row()];
-  
   if (role == Qt::DisplayRole) {
-    char buffer[1023];
-    snprintf(buffer, sizeof(buffer), "%s (%lu)",
-             name.c_str(),
-             data_.find(name)->second);
-    return QVariant(QString(buffer));
+    return QVariant(QString("%1  %2")
+                    .arg(static_cast<qulonglong>(log_template.count), 7)
+                    .arg(log_template.pattern));
+  } else if (role == Qt::ToolTipRole) {
+    return QVariant(QString("%1 messages in %2 entries")
+                    .arg(static_cast<qulonglong>(log_template.count))
+                    .arg(static_cast<qulonglong>(log_template.members.size())));
   }
 
   return QVariant();
 }
 
-void NodeListModel::clear()
+void TemplateListModel::handleDatabaseCleared()
 {
-  if (ordering_.empty()) {
-    return;
-  }
-  beginRemoveRows(QModelIndex(), 0, ordering_.size()-1);
-  data_.clear();
-  ordering_.clear();
-  endRemoveRows();
+  // Unlike the node list, templates have no meaning without the
+  // messages they were derived from, so they're removed entirely.
+  beginResetModel();
+  row_count_ = db_->templateCount();
+  endResetModel();
 }
 
-void NodeListModel::handleDatabaseCleared()
+void TemplateListModel::handleMessagesAdded()
 {
-  // When the database is cleared, we reset all of the counts to zero
-  // instead of deleting them from the list.  This allows a user to
-  // clear out the logs while retaining their node selection so that
-  // they can easily reset the data without having to choose the
-  // selection again.  
-  std::map<std::string, size_t>::iterator iter;
-  for (iter = data_.begin(); iter != data_.end(); ++iter) {
-    (*iter).second = 0;
+  // Templates are only ever appended, so existing rows keep their
+  // position.  There are typically a few hundred templates at most,
+  // so it's cheap to refresh all of the counts.
+  size_t old_count = row_count_;
+  if (db_->templateCount() > old_count) {
+    beginInsertRows(QModelIndex(), old_count, db_->templateCount() - 1);
+    row_count_ = db_->templateCount();
+    endInsertRows();
   }
 
-  Q_EMIT dataChanged(index(0), index(data_.size()-1));
-}
-
-void NodeListModel::handleMessagesAdded()
-{
-  const std::map<std::string, size_t> &msg_counts = db_->messageCounts();
-  
-  size_t i = 0;
-  for (std::map<std::string, size_t>::const_iterator it = msg_counts.begin();
-       it != msg_counts.end();
-       ++it)
-  {
-    if (!data_.count(it->first)) {
-      beginInsertRows(QModelIndex(), i, i);
-      data_[it->first] = it->second;
-      ordering_.insert(ordering_.begin() + i, it->first);
-      endInsertRows();
-    } else {
-      data_[it->first] = it->second;
-    }
-    i++;
+  if (old_count) {
+    Q_EMIT dataChanged(index(0), index(old_count - 1));
   }
-  
-  Q_EMIT dataChanged(index(0),
-                     index(ordering_.size()-1));
 }
 }  // namespace swri_console
@@ -0,0 +1,774 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <queue>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QMessageBox>
+#include <QProgressDialog>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <swri_console/text_log_reader.h>
+
+namespace swri_console
+{
+  // Files are split into chunks of about this many bytes, which are
+  // parsed in parallel.
+  static const qint64 CHUNK_SIZE = 16 << 20;
+
+  // At most this many batches may be waiting for the GUI thread to add
+  // them to the database before the reader waits.
+  static const int MAX_PENDING_BATCHES = 4;
+
+  // Merged messages are delivered in batches of this size.
+  static const size_t BATCH_SIZE = 10000;
+
+  namespace
+  {
+    bool isDigit(char c)
+    {
+      return c >= '0' && c <= '9';
+    }
+
+    void skipSpaces(const char*& p, const char* end)
+    {
+      while (p < end && *p == ' ') {
+        p++;
+      }
+    }
+
+    // Finds the first occurrence of str in [begin, end), or returns end.
+    const char* find(const char* begin, const char* end, const char* str)
+    {
+      return std::search(begin, end, str, str + strlen(str));
+    }
+
+    bool levelFromName(const char* begin, const char* end, uint8_t* level)
+    {
+      // Console output pads names to 5 characters, e.g. "[ INFO]".
+      while (begin < end && *begin == ' ') {
+        begin++;
+      }
+      const std::string name(begin, end);
+      if (name == "DEBUG") {
+        *level = rosgraph_msgs::Log::DEBUG;
+      } else if (name == "INFO") {
+        *level = rosgraph_msgs::Log::INFO;
+      } else if (name == "WARN" || name == "WARNING") {
+        *level = rosgraph_msgs::Log::WARN;
+      } else if (name == "ERROR") {
+        *level = rosgraph_msgs::Log::ERROR;
+      } else if (name == "FATAL" || name == "CRITICAL") {
+        *level = rosgraph_msgs::Log::FATAL;
+      } else {
+        return false;
+      }
+      return true;
+    }
+
+    // Parses a "<sec>.<nsec>" stamp, advancing p past it.
+    bool parseStamp(const char*& p, const char* end, ros::Time* stamp)
+    {
+      const char* start = p;
+      uint64_t sec = 0;
+      while (p < end && isDigit(*p) && sec <= 0xFFFFFFFFull) {
+        sec = sec * 10 + (*p - '0');
+        p++;
+      }
+      if (p == start || p >= end || *p != '.' || sec > 0xFFFFFFFFull) {
+        return false;
+      }
+      p++;
+
+      uint32_t nsec = 0;
+      int digits = 0;
+      while (p < end && isDigit(*p)) {
+        if (digits < 9) {
+          nsec = nsec * 10 + (*p - '0');
+          digits++;
+        }
+        p++;
+      }
+      if (digits == 0) {
+        return false;
+      }
+      for (; digits < 9; digits++) {
+        nsec *= 10;
+      }
+
+      stamp->sec = sec;
+      stamp->nsec = nsec;
+      return true;
+    }
+
+    // Splits "<file>:<line>(<function>)".
+    void parseLocation(const char* begin, const char* end, rosgraph_msgs::Log* log)
+    {
+      for (const char* c = begin; c < end; c++) {
+        if (*c != ':') {
+          continue;
+        }
+        const char* d = c + 1;
+        uint32_t line = 0;
+        while (d < end && isDigit(*d)) {
+          line = line * 10 + (*d - '0');
+          d++;
+        }
+        if (d > c + 1 && d < end && *d == '(') {
+          log->file.assign(begin, c);
+          log->line = line;
+          const char* function_end = (*(end - 1) == ')') ? end - 1 : end;
+          log->function.assign(d + 1, function_end);
+          return;
+        }
+      }
+      log->file.assign(begin, end);
+    }
+
+    // "<stamp> <LEVEL> <node> [<file>:<line>(<function>)] [topics: ...] <msg>"
+    bool parseRosoutRecord(const char* p, const char* end, rosgraph_msgs::Log* log)
+    {
+      if (!parseStamp(p, end, &log->header.stamp)) {
+        return false;
+      }
+      skipSpaces(p, end);
+
+      const char* level = p;
+      while (p < end && *p != ' ') {
+        p++;
+      }
+      if (!levelFromName(level, p, &log->level)) {
+        return false;
+      }
+      skipSpaces(p, end);
+
+      const char* name = p;
+      while (p < end && *p != ' ') {
+        p++;
+      }
+      if (p == name) {
+        return false;
+      }
+      log->name.assign(name, p);
+      skipSpaces(p, end);
+
+      if (p >= end || *p != '[') {
+        return false;
+      }
+      const char* topics = find(p, end, "] [topics: ");
+      if (topics == end) {
+        return false;
+      }
+      parseLocation(p + 1, topics, log);
+
+      const char* topics_end = find(topics + 1, end, "] ");
+      if (topics_end == end) {
+        log->msg.clear();
+      } else {
+        log->msg.assign(topics_end + 2, end);
+      }
+      return true;
+    }
+
+    // "[ INFO] [<stamp>]: <msg>" or "[ INFO] [<stamp>, <sim time>]: <msg>",
+    // possibly wrapped in terminal color codes.
+    bool parseConsoleRecord(const char* p, const char* end, rosgraph_msgs::Log* log)
+    {
+      if (p < end && *p == '\x1b') {
+        while (p < end && *p != 'm') {
+          p++;
+        }
+        p++;
+      }
+
+      if (p >= end || *p != '[') {
+        return false;
+      }
+      const char* level = ++p;
+      while (p < end && *p != ']') {
+        p++;
+      }
+      if (p >= end || !levelFromName(level, p, &log->level)) {
+        return false;
+      }
+      p++;
+      skipSpaces(p, end);
+
+      if (p >= end || *p != '[') {
+        return false;
+      }
+      p++;
+      if (!parseStamp(p, end, &log->header.stamp)) {
+        return false;
+      }
+      while (p < end && *p != ']') {
+        p++;
+      }
+      if (end - p < 2 || p[1] != ':') {
+        return false;
+      }
+      p += 2;
+      skipSpaces(p, end);
+
+      // Drop the color reset at the end of the line.
+      if (end - p >= 4 && std::memcmp(end - 4, "\x1b[0m", 4) == 0) {
+        end -= 4;
+      }
+      log->msg.assign(p, end);
+      return true;
+    }
+
+    // "[<logger>][INFO] 2019-01-08 12:00:00,123: <msg>"
+    bool parseRospyRecord(const char* p, const char* end, rosgraph_msgs::Log* log)
+    {
+      if (p >= end || *p != '[') {
+        return false;
+      }
+      p = find(p, end, "][");
+      if (p == end) {
+        return false;
+      }
+      const char* level = p + 2;
+      p = std::find(level, end, ']');
+      if (p == end || !levelFromName(level, p, &log->level)) {
+        return false;
+      }
+      p++;
+      skipSpaces(p, end);
+
+      static const int TIME_LENGTH = 23;
+      if (end - p < TIME_LENGTH + 1 || p[TIME_LENGTH] != ':') {
+        return false;
+      }
+      QDateTime time = QDateTime::fromString(QString::fromLatin1(p, TIME_LENGTH),
+                                             "yyyy-MM-dd HH:mm:ss,zzz");
+      if (!time.isValid()) {
+        return false;
+      }
+      const qint64 msecs = time.toMSecsSinceEpoch();
+      log->header.stamp.sec = msecs / 1000;
+      log->header.stamp.nsec = (msecs % 1000) * 1000000;
+      p += TIME_LENGTH + 1;
+      skipSpaces(p, end);
+
+      log->msg.assign(p, end);
+      return true;
+    }
+
+    const char* lineEnd(const char* p, const char* end)
+    {
+      const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+      return newline ? newline : end;
+    }
+
+    // Strips a trailing carriage return.
+    const char* contentEnd(const char* begin, const char* line_end)
+    {
+      return (line_end > begin && *(line_end - 1) == '\r') ? line_end - 1 : line_end;
+    }
+
+    // Returns the start of the first line at or after p that starts a
+    // message.
+    const char* findRecordStart(const char* p, const char* end, const std::string& default_node)
+    {
+      rosgraph_msgs::Log log;
+      while (p < end) {
+        const char* line_end = lineEnd(p, end);
+        if (parseTextLogRecord(p, contentEnd(p, line_end), default_node, &log)) {
+          return p;
+        }
+        p = line_end + 1;
+      }
+      return end;
+    }
+
+    /**
+     * Parses the messages in one chunk of a file.
+     */
+    class ParseTask : public QRunnable
+    {
+    public:
+      ParseTask(const char* begin, const char* end,
+                const std::string& default_node,
+                volatile bool* cancelled,
+                std::vector<rosgraph_msgs::LogPtr>* msgs,
+                QSemaphore* done) :
+        begin_(begin),
+        end_(end),
+        default_node_(default_node),
+        cancelled_(cancelled),
+        msgs_(msgs),
+        done_(done)
+      {
+      }
+
+      void run()
+      {
+        parse();
+        done_->release();
+      }
+
+    private:
+      void parse()
+      {
+        rosgraph_msgs::LogPtr log = boost::make_shared<rosgraph_msgs::Log>();
+        size_t lines = 0;
+
+        const char* p = begin_;
+        while (p < end_) {
+          // Checking the flag on every line would be wasteful.
+          if ((++lines & 0xFFFF) == 0 && *cancelled_) {
+            return;
+          }
+
+          const char* line_end = lineEnd(p, end_);
+          const char* content_end = contentEnd(p, line_end);
+
+          if (parseTextLogRecord(p, content_end, default_node_, log.get())) {
+            msgs_->push_back(log);
+            log = boost::make_shared<rosgraph_msgs::Log>();
+          } else if (!msgs_->empty()) {
+            // A continuation of a multi-line message.
+            msgs_->back()->msg += '\n';
+            msgs_->back()->msg.append(p, content_end);
+          }
+
+          p = line_end + 1;
+        }
+      }
+
+      const char* begin_;
+      const char* end_;
+      std::string default_node_;
+      volatile bool* cancelled_;
+      std::vector<rosgraph_msgs::LogPtr>* msgs_;
+      QSemaphore* done_;
+    };
+
+    /**
+     * A chunk of a file that has been handed to a ParseTask.  done is
+     * released once msgs is filled in.
+     */
+    struct ParsedChunk
+    {
+      ParsedChunk() : ready(false), bytes(0) {}
+
+      std::vector<rosgraph_msgs::LogPtr> msgs;
+      QSemaphore done;
+      bool ready;
+      qint64 bytes;
+    };
+
+    struct MergeHead
+    {
+      ros::Time time;
+      size_t source;
+
+      bool operator<(const MergeHead& other) const
+      {
+        if (time != other.time) {
+          return time > other.time;
+        }
+        return source > other.source;
+      }
+    };
+  }
+
+  /**
+   * One file being merged with the others.  A few of its chunks are
+   * parsed ahead of the one being delivered.
+   */
+  struct TextLogStream
+  {
+    TextLogStream() : file(NULL), data(NULL), next_chunk(0), position(0) {}
+
+    QFile* file;
+    uchar* data;
+    std::string default_node;
+    // Chunk boundaries, which always fall at the start of a message.
+    std::vector<const char*> bounds;
+    size_t next_chunk;
+    std::deque<ParsedChunk*> chunks;
+    size_t position;
+  };
+
+  bool parseTextLogRecord(const char* begin, const char* end,
+                          const std::string& default_node,
+                          rosgraph_msgs::Log* log)
+  {
+    if (begin == end) {
+      return false;
+    }
+    if (isDigit(*begin)) {
+      return parseRosoutRecord(begin, end, log);
+    }
+    if (parseConsoleRecord(begin, end, log) || parseRospyRecord(begin, end, log)) {
+      log->name = default_node;
+      return true;
+    }
+    return false;
+  }
+
+  std::string textLogNodeName(const QString& filename)
+  {
+    // Node logs are named like "talker-1.log" or "talker-1-stdout.log".
+    QString name = QFileInfo(filename).completeBaseName();
+    if (name.endsWith("-stdout") || name.endsWith("-stderr")) {
+      name.chop(7);
+    }
+    int dash = name.lastIndexOf('-');
+    if (dash > 0 && name.mid(dash + 1).toInt() > 0) {
+      name = name.left(dash);
+    }
+    return "/" + name.toStdString();
+  }
+
+  TextLogReaderThread::TextLogReaderThread(const QStringList& filenames) :
+    filenames_(filenames),
+    cancelled_(false),
+    batch_slots_(MAX_PENDING_BATCHES),
+    total_bytes_(0),
+    done_bytes_(0),
+    last_progress_(-1)
+  {
+  }
+
+  void TextLogReaderThread::batchDelivered()
+  {
+    batch_slots_.release();
+  }
+
+  void TextLogReaderThread::cancel()
+  {
+    cancelled_ = true;
+  }
+
+  void TextLogReaderThread::run()
+  {
+    for (int i = 0; i < filenames_.size(); i++) {
+      total_bytes_ += QFileInfo(filenames_[i]).size();
+    }
+
+    std::vector<TextLogStream> streams;
+    for (int i = 0; i < filenames_.size() && error_.isEmpty(); i++) {
+      TextLogStream stream;
+      if (openFile(filenames_[i], &stream)) {
+        streams.push_back(stream);
+      }
+    }
+
+    if (error_.isEmpty()) {
+      readMerged(&streams);
+    }
+
+    for (size_t i = 0; i < streams.size(); i++) {
+      if (streams[i].data) {
+        streams[i].file->unmap(streams[i].data);
+      }
+      delete streams[i].file;
+    }
+  }
+
+  void TextLogReaderThread::reportProgress(qint64 bytes)
+  {
+    done_bytes_ += bytes;
+    if (total_bytes_ <= 0) {
+      return;
+    }
+    int permille = static_cast<int>(done_bytes_ * 1000 / total_bytes_);
+    if (permille != last_progress_) {
+      last_progress_ = permille;
+      emit progress(permille);
+    }
+  }
+
+  bool TextLogReaderThread::openFile(const QString& filename, TextLogStream* stream)
+  {
+    QFile* file = new QFile(filename);
+    if (!file->open(QIODevice::ReadOnly)) {
+      error_ = tr("%1: %2").arg(filename).arg(file->errorString());
+      delete file;
+      return false;
+    }
+    if (file->size() == 0) {
+      delete file;
+      return false;
+    }
+
+    uchar* data = file->map(0, file->size());
+    if (!data) {
+      error_ = tr("%1: %2").arg(filename).arg(file->errorString());
+      delete file;
+      return false;
+    }
+    const char* begin = reinterpret_cast<const char*>(data);
+    const char* end = begin + file->size();
+
+    stream->file = file;
+    stream->data = data;
+    stream->default_node = textLogNodeName(filename);
+
+    // Chunks start at the beginning of a message, so that a multi-line
+    // message is never split between two tasks.
+    stream->bounds.push_back(begin);
+    while (stream->bounds.back() < end) {
+      const char* p = stream->bounds.back() + std::min<qint64>(CHUNK_SIZE, end - stream->bounds.back());
+      if (p < end) {
+        p = findRecordStart(lineEnd(p, end) + 1, end, stream->default_node);
+      }
+      stream->bounds.push_back(std::min(p, end));
+    }
+    return true;
+  }
+
+  void TextLogReaderThread::readMerged(std::vector<TextLogStream>* streams)
+  {
+    // Each file is parsed a few chunks ahead of the one being
+    // delivered, so that the pool stays busy while memory stays
+    // bounded.  With many files, each only needs one chunk ahead.
+    QThreadPool pool;
+    const size_t chunks_in_flight = 2 * std::max(1, pool.maxThreadCount());
+    const size_t depth = std::max<size_t>(1, chunks_in_flight / std::max<size_t>(1, streams->size()));
+
+    std::priority_queue<MergeHead> heads;
+    for (size_t i = 0; i < streams->size(); i++) {
+      scheduleChunks(&pool, &(*streams)[i], depth);
+    }
+    for (size_t i = 0; i < streams->size(); i++) {
+      if (nextMessage(&pool, &(*streams)[i], depth)) {
+        MergeHead head;
+        head.time = currentMessage((*streams)[i])->header.stamp;
+        head.source = i;
+        heads.push(head);
+      }
+    }
+
+    // Messages from all of the files are merged by stamp, so that nodes
+    // are interleaved the same way they would be when merging bags.
+    // The files don't record sequence numbers, so messages are numbered
+    // in the order they are delivered.
+    uint32_t seq = 0;
+    MessageList msgs;
+    while (!heads.empty() && !cancelled_) {
+      const size_t i = heads.top().source;
+      heads.pop();
+      TextLogStream& stream = (*streams)[i];
+
+      rosgraph_msgs::LogPtr log = currentMessage(stream);
+      log->header.seq = seq++;
+      msgs.push_back(log);
+      stream.position++;
+
+      if (nextMessage(&pool, &stream, depth)) {
+        MergeHead head;
+        head.time = currentMessage(stream)->header.stamp;
+        head.source = i;
+        heads.push(head);
+      }
+
+      if (msgs.size() >= BATCH_SIZE) {
+        deliver(&msgs);
+      }
+    }
+    if (!msgs.empty()) {
+      deliver(&msgs);
+    }
+
+    // If we were cancelled, the tasks notice the flag and stop early.
+    pool.waitForDone();
+    for (size_t i = 0; i < streams->size(); i++) {
+      for (size_t j = 0; j < (*streams)[i].chunks.size(); j++) {
+        delete (*streams)[i].chunks[j];
+      }
+      (*streams)[i].chunks.clear();
+    }
+  }
+
+  void TextLogReaderThread::scheduleChunks(QThreadPool* pool, TextLogStream* stream, size_t depth)
+  {
+    while (stream->chunks.size() < depth && stream->next_chunk + 1 < stream->bounds.size()) {
+      const size_t k = stream->next_chunk++;
+      ParsedChunk* chunk = new ParsedChunk();
+      chunk->bytes = stream->bounds[k + 1] - stream->bounds[k];
+      stream->chunks.push_back(chunk);
+      pool->start(new ParseTask(stream->bounds[k], stream->bounds[k + 1],
+                                stream->default_node, &cancelled_,
+                                &chunk->msgs, &chunk->done));
+    }
+  }
+
+  bool TextLogReaderThread::nextMessage(QThreadPool* pool, TextLogStream* stream, size_t depth)
+  {
+    while (!stream->chunks.empty() && !cancelled_) {
+      ParsedChunk* chunk = stream->chunks.front();
+      if (!chunk->ready) {
+        chunk->done.acquire();
+        chunk->ready = true;
+      }
+      if (stream->position < chunk->msgs.size()) {
+        return true;
+      }
+
+      reportProgress(chunk->bytes);
+      delete chunk;
+      stream->chunks.pop_front();
+      stream->position = 0;
+      scheduleChunks(pool, stream, depth);
+    }
+    return false;
+  }
+
+  const rosgraph_msgs::LogPtr& TextLogReaderThread::currentMessage(const TextLogStream& stream)
+  {
+    return stream.chunks.front()->msgs[stream.position];
+  }
+
+  void TextLogReaderThread::deliver(MessageList* msgs)
+  {
+    // Wait for the GUI thread to catch up, so that parsed batches
+    // don't pile up in its event queue.
+    while (!cancelled_ && !batch_slots_.tryAcquire(1, 100)) {
+    }
+    if (!cancelled_) {
+      emit messagesRead(*msgs);
+    }
+    msgs->clear();
+  }
+
+  TextLogReader::TextLogReader() :
+    thread_(NULL),
+    progress_dialog_(NULL)
+  {
+  }
+
+  TextLogReader::~TextLogReader()
+  {
+    if (thread_)
+    {
+      thread_->cancel();
+      thread_->wait();
+      delete thread_;
+    }
+    delete progress_dialog_;
+  }
+
+  void TextLogReader::readTextLogs(const QStringList& filenames)
+  {
+    if (thread_)
+    {
+      QMessageBox::information(NULL, tr("Open Text Logs"),
+                               tr("Text logs are already being read."));
+      return;
+    }
+
+    thread_ = new TextLogReaderThread(filenames);
+    // Batches are emitted from the reader thread, so this connection is
+    // queued and the batches are delivered on the GUI thread.
+    QObject::connect(thread_, SIGNAL(messagesRead(const MessageList&)),
+                     this, SLOT(deliverBatch(const MessageList&)));
+    QObject::connect(thread_, SIGNAL(finished()),
+                     this, SLOT(handleThreadFinished()));
+
+    QString label = tr("Reading %1...").arg(filenames[0]);
+    if (filenames.size() > 1)
+    {
+      label = tr("Reading %1 log files...").arg(filenames.size());
+    }
+    progress_dialog_ = new QProgressDialog(label, tr("Cancel"), 0, 1000);
+    progress_dialog_->setMinimumDuration(500);
+    QObject::connect(thread_, SIGNAL(progress(int)),
+                     progress_dialog_, SLOT(setValue(int)));
+    QObject::connect(progress_dialog_, SIGNAL(canceled()),
+                     this, SLOT(cancelReading()));
+
+    thread_->start();
+  }
+
+  void TextLogReader::deliverBatch(const MessageList& msgs)
+  {
+    // The database adds the messages as soon as they are received, so
+    // the batch no longer counts against the reader once this returns.
+    emit logsReceived(msgs);
+    if (thread_)
+    {
+      thread_->batchDelivered();
+    }
+  }
+
+  void TextLogReader::cancelReading()
+  {
+    if (thread_)
+    {
+      thread_->cancel();
+    }
+  }
+
+  void TextLogReader::handleThreadFinished()
+  {
+    QString error = thread_->errorString();
+    thread_->deleteLater();
+    thread_ = NULL;
+    progress_dialog_->deleteLater();
+    progress_dialog_ = NULL;
+
+    if (!error.isEmpty())
+    {
+      QMessageBox::warning(NULL, tr("Open Text Logs"),
+                           tr("Failed to read log file %1").arg(error));
+    }
+
+    emit finishedReading();
+  }
+
+  void TextLogReader::promptForTextLogs()
+  {
+    QStringList filenames = QFileDialog::getOpenFileNames(NULL,
+                                                          tr("Open Text Logs"),
+                                                          QDir::homePath() + "/.ros/log",
+                                                          tr("Log Files (*.log);;All Files (*)"));
+
+    if (!filenames.isEmpty())
+    {
+      readTextLogs(filenames);
+    }
+  }
+}
@@ -0,0 +1,197 @@
+// *****************************************************************************
+//
+// Copyright (c) 2015, Southwest Research Institute® (SwRI®)
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//     * Redistributions of source code must retain the above copyright
+//       notice, this list of conditions and the following disclaimer.
+//     * Redistributions in binary form must reproduce the above copyright
+//       notice, this list of conditions and the following disclaimer in the
+//       documentation and/or other materials provided with the distribution.
+//     * Neither the name of Southwest Research Institute® (SwRI®) nor the
+//       names of its contributors may be used to endorse or promote products
+//       derived from this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL Southwest Research Institute® BE LIABLE 
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL 
+// DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+// SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+// CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT 
+// LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY 
+// OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+//
+// *****************************************************************************
+
+#include <cstring>
+
+#include <QFile>
+#include <QMutexLocker>
+
+#include <swri_console/log_store.h>
+#include <swri_console/tiered_body_source.h>
+
+namespace swri_console
+{
+static const size_t NO_CHUNK = static_cast<size_t>(-1);
+
+TieredBodySource::TieredBodySource()
+  :
+  compressed_bytes_(0),
+  spilled_bytes_(0),
+  dropped_entries_(0),
+  cached_chunk_(NO_CHUNK)
+{
+}
+
+// Each entry's lines are joined with newlines, which is how they were
+// split in the first place, and stored as UTF-8 after a length.
+void TieredBodySource::compress(size_t chunk, const std::vector<QStringList> &texts)
+{
+  QByteArray raw;
+  size_t entries = 0;
+  for (size_t i = 0; i < texts.size(); i++) {
+    if (!texts[i].isEmpty()) {
+      entries++;
+    }
+    const QByteArray utf8 = texts[i].join("\n").toUtf8();
+    const uint32_t length = utf8.size();
+    raw.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    raw.append(utf8);
+  }
+
+  Chunk compressed;
+  compressed.tier = COMPRESSED;
+  compressed.data = qCompress(raw);
+  compressed.size = compressed.data.size();
+  compressed.entries = entries;
+
+  QMutexLocker lock(&mutex_);
+  chunks_[chunk] = compressed;
+  compressed_bytes_ += compressed.size;
+}
+
+QString TieredBodySource::spillPath(size_t chunk) const
+{
+  return spill_dir_.path() + QString("/chunk-%1").arg(chunk);
+}
+
+bool TieredBodySource::spill(size_t chunk)
+{
+  QMutexLocker lock(&mutex_);
+  std::map<size_t, Chunk>::iterator it = chunks_.find(chunk);
+  if (it == chunks_.end() || it->second.tier != COMPRESSED || !spill_dir_.isValid()) {
+    return false;
+  }
+
+  QFile file(spillPath(chunk));
+  if (!file.open(QIODevice::WriteOnly) ||
+      file.write(it->second.data) != it->second.size ||
+      !file.flush()) {
+    file.close();
+    QFile::remove(spillPath(chunk));
+    return false;
+  }
+
+  it->second.tier = SPILLED;
+  it->second.data.clear();
+  compressed_bytes_ -= it->second.size;
+  spilled_bytes_ += it->second.size;
+  return true;
+}
+
+void TieredBodySource::drop(size_t chunk)
+{
+  QMutexLocker lock(&mutex_);
+  std::map<size_t, Chunk>::iterator it = chunks_.find(chunk);
+  if (it == chunks_.end() || it->second.tier == DROPPED) {
+    return;
+  }
+
+  dropped_entries_ += it->second.entries;
+  if (it->second.tier == COMPRESSED) {
+    compressed_bytes_ -= it->second.size;
+  } else if (it->second.tier == SPILLED) {
+    spilled_bytes_ -= it->second.size;
+    QFile::remove(spillPath(chunk));
+  }
+  it->second.tier = DROPPED;
+  it->second.data.clear();
+  it->second.size = 0;
+
+  if (cached_chunk_ == chunk) {
+    cached_chunk_ = NO_CHUNK;
+    cached_texts_.clear();
+  }
+}
+
+bool TieredBodySource::loadChunk(size_t chunk)
+{
+  if (cached_chunk_ == chunk) {
+    return true;
+  }
+
+  std::map<size_t, Chunk>::const_iterator it = chunks_.find(chunk);
+  if (it == chunks_.end() || it->second.tier == DROPPED) {
+    return false;
+  }
+
+  QByteArray raw;
+  if (it->second.tier == COMPRESSED) {
+    raw = qUncompress(it->second.data);
+  } else {
+    QFile file(spillPath(chunk));
+    if (!file.open(QIODevice::ReadOnly)) {
+      return false;
+    }
+    raw = qUncompress(file.readAll());
+  }
+
+  cached_texts_.clear();
+  int offset = 0;
+  while (offset + static_cast<int>(sizeof(uint32_t)) <= raw.size()) {
+    uint32_t length = 0;
+    std::memcpy(&length, raw.constData() + offset, sizeof(length));
+    offset += sizeof(length);
+    if (offset + static_cast<qint64>(length) > raw.size()) {
+      break;
+    }
+    cached_texts_.push_back(QString::fromUtf8(raw.constData() + offset, length).split('\n'));
+    offset += length;
+  }
+  cached_chunk_ = chunk;
+  return true;
+}
+
+QStringList TieredBodySource::text(uint64_t locator)
+{
+  std::vector<QStringList> texts;
+  textRange(locator, 1, &texts);
+  if (texts.empty()) {
+    return QStringList();
+  }
+  return texts[0];
+}
+
+void TieredBodySource::textRange(uint64_t first, size_t count, std::vector<QStringList> *texts)
+{
+  texts->clear();
+
+  QMutexLocker lock(&mutex_);
+  for (uint64_t locator = first; locator < first + count; locator++) {
+    const size_t chunk = locator / LogStore::chunkSize();
+    const size_t offset = locator % LogStore::chunkSize();
+    if (loadChunk(chunk)) {
+      texts->push_back(offset < cached_texts_.size() ? cached_texts_[offset] : QStringList());
+    } else {
+      texts->push_back(QStringList(
+        QString("[Message text dropped to stay within the memory budget]")));
+    }
+  }
+}
+}  // namespace swri_console